@@ -0,0 +1,51 @@
+/**
+ * Compares the time to serialize plain objects with `v8.serialize`.
+ *
+ *   npm run bench
+ *
+ * Rows holding a symbol are serialized twice, see "Plain objects and
+ * symbols" in the README.
+ */
+import { serialize } from 'node:v8';
+import { Serialism } from '..';
+
+const symbol = Symbol.for('active');
+
+function rows(withSymbol: boolean) {
+  return Array.from({ length: 2000 }, (_, i) => ({
+    id: i,
+    name: `user ${i}`,
+    active: withSymbol && i === 1999 ? symbol : i % 2 === 0,
+    score: i * 1.5,
+    address: { street: `${i} Main St`, city: 'Springfield', zip: 10000 + i },
+    tags: ['a', 'b', 'c'],
+  }));
+}
+
+function measure(run: () => unknown, iterations = 200): number {
+  for (let i = 0; i < 20; ++i) {
+    run();
+  }
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < iterations; ++i) {
+    run();
+  }
+  return Number(process.hrtime.bigint() - start) / 1e6 / iterations;
+}
+
+const plain = { rows: rows(false), meta: { page: 1 } };
+const baseline = measure(() => serialize(plain));
+console.log(`v8.serialize            ${baseline.toFixed(3)} ms`);
+for (const traversal of ['recursive', 'iterative'] as const) {
+  const serializer = new Serialism({ traversal });
+  for (const [label, value] of [
+    ['plain', plain],
+    ['one symbol', { rows: rows(true), meta: { page: 1 } }],
+  ] as const) {
+    const time = measure(() => serializer.serialize(value));
+    const ratio = (time / baseline).toFixed(2);
+    console.log(
+      `${`${traversal}, ${label}`.padEnd(24)}${time.toFixed(3)} ms (${ratio}x)`,
+    );
+  }
+}
@@ -1,10 +1,22 @@
 {
   "targets": [
+    {
+      "target_name": "serialism_format",
+      "type": "none",
+      "direct_dependent_settings": {
+        "include_dirs": [
+          "include"
+        ]
+      }
+    },
     {
       "include_dirs": [
         "<!(node -e \"require('nan')\")"
       ],
       "target_name": "serialism",
+      "dependencies": [
+        "serialism_format"
+      ],
       "sources": [
         "src/native.cxx"
       ]
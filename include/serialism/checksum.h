@@ -0,0 +1,387 @@
+#ifndef SERIALISM_CHECKSUM_H
+#define SERIALISM_CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  define SERIALISM_CRC32C_X86 1
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#  include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#  define SERIALISM_CRC32C_ARM 1
+#  include <arm_acle.h>
+#endif
+
+#if defined(SERIALISM_CRC32C_X86) && !defined(_MSC_VER)
+#  define SERIALISM_TARGET_SSE42 __attribute__((target("sse4.2")))
+#else
+#  define SERIALISM_TARGET_SSE42
+#endif
+
+/**
+ * Optional integrity trailer for serialized payloads.
+ *
+ * The payload is split into fixed-size blocks and the CRC32C (Castagnoli) of
+ * every block is appended after it, followed by a fixed-size footer:
+ *
+ *   [payload][crc 0]...[crc n-1][block size][block count][magic]
+ *
+ * All trailer fields are little-endian `uint32_t`. Because every block carries
+ * its own checksum, a reader can verify a payload block by block (for example
+ * while streaming it from disk) and report the first corrupted block.
+ */
+namespace serialism {
+  namespace checksum {
+    constexpr uint32_t kBlockSize = 64 * 1024;
+    constexpr uint32_t kTrailerMagic = 0x4b435253; // "SRCK"
+    constexpr size_t kFooterSize = 3 * sizeof(uint32_t);
+
+    enum class Status {
+      kOk = 0,          // All blocks match
+      kMissingTrailer,  // No trailer magic at the end of the data
+      kMalformedTrailer, // Trailer fields are inconsistent with the data
+      kMismatch,        // A block does not match its checksum
+    };
+
+    /**
+     * A parsed view over the trailer of a checksummed payload.
+     */
+    struct Trailer {
+      const uint8_t* crcs = nullptr; // Little-endian block checksums
+      size_t payloadSize = 0;
+      uint32_t blockSize = 0;
+      uint32_t blockCount = 0;
+    };
+
+    namespace detail {
+      constexpr uint32_t kPolynomial = 0x82f63b78; // Reversed Castagnoli
+
+      struct Tables {
+        uint32_t t[8][256] = {};
+        constexpr Tables() {
+          for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int k = 0; k < 8; ++k) {
+              crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+            }
+            t[0][i] = crc;
+          }
+          for (uint32_t i = 0; i < 256; ++i) {
+            for (int s = 1; s < 8; ++s) {
+              t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+            }
+          }
+        }
+      };
+
+      inline const Tables& GetTables() {
+        static constexpr Tables tables;
+        return tables;
+      }
+
+      inline uint64_t Load64(const uint8_t* p) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        v = __builtin_bswap64(v);
+#endif
+        return v;
+      }
+
+      inline uint32_t Load32LE(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) |
+          (static_cast<uint32_t>(p[1]) << 8) |
+          (static_cast<uint32_t>(p[2]) << 16) |
+          (static_cast<uint32_t>(p[3]) << 24);
+      }
+
+      inline void Store32LE(uint8_t* p, uint32_t v) {
+        p[0] = static_cast<uint8_t>(v);
+        p[1] = static_cast<uint8_t>(v >> 8);
+        p[2] = static_cast<uint8_t>(v >> 16);
+        p[3] = static_cast<uint8_t>(v >> 24);
+      }
+
+      // Slicing-by-8 software implementation, operates on the raw register.
+      inline uint32_t ExtendSoftware(uint32_t l, const uint8_t* p, size_t n) {
+        const Tables& tab = GetTables();
+        while (n >= 8) {
+          uint64_t v = Load64(p) ^ l;
+          l = tab.t[7][v & 0xff] ^ tab.t[6][(v >> 8) & 0xff] ^
+            tab.t[5][(v >> 16) & 0xff] ^ tab.t[4][(v >> 24) & 0xff] ^
+            tab.t[3][(v >> 32) & 0xff] ^ tab.t[2][(v >> 40) & 0xff] ^
+            tab.t[1][(v >> 48) & 0xff] ^ tab.t[0][v >> 56];
+          p += 8;
+          n -= 8;
+        }
+        while (n--) {
+          l = tab.t[0][(l ^ *p++) & 0xff] ^ (l >> 8);
+        }
+        return l;
+      }
+
+#if defined(SERIALISM_CRC32C_X86)
+      inline bool HasHardware() {
+        static const bool supported = [] {
+#  if defined(_MSC_VER)
+          int info[4];
+          __cpuid(info, 1);
+          return (info[2] & (1 << 20)) != 0;
+#  else
+          unsigned int eax, ebx, ecx, edx;
+          if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            return false;
+          }
+          return (ecx & bit_SSE4_2) != 0;
+#  endif
+        }();
+        return supported;
+      }
+
+      SERIALISM_TARGET_SSE42 inline uint32_t ExtendHardware(
+        uint32_t l, const uint8_t* p, size_t n) {
+        uint64_t l64 = l;
+        while (n >= 8) {
+          uint64_t v;
+          std::memcpy(&v, p, sizeof(v));
+          l64 = _mm_crc32_u64(l64, v);
+          p += 8;
+          n -= 8;
+        }
+        l = static_cast<uint32_t>(l64);
+        while (n--) {
+          l = _mm_crc32_u8(l, *p++);
+        }
+        return l;
+      }
+
+      // The crc32 instruction has a latency of three cycles but a throughput
+      // of one per cycle, so three independent blocks are hashed in lockstep.
+      SERIALISM_TARGET_SSE42 inline void ExtendHardware3(
+        uint32_t* out, const uint8_t* a, const uint8_t* b, const uint8_t* c,
+        size_t n) {
+        uint64_t la = 0xffffffffu, lb = 0xffffffffu, lc = 0xffffffffu;
+        for (size_t i = 0; i + 8 <= n; i += 8) {
+          uint64_t va, vb, vc;
+          std::memcpy(&va, a + i, 8);
+          std::memcpy(&vb, b + i, 8);
+          std::memcpy(&vc, c + i, 8);
+          la = _mm_crc32_u64(la, va);
+          lb = _mm_crc32_u64(lb, vb);
+          lc = _mm_crc32_u64(lc, vc);
+        }
+        size_t tail = n & ~size_t(7);
+        out[0] = ExtendHardware(uint32_t(la), a + tail, n - tail) ^ 0xffffffffu;
+        out[1] = ExtendHardware(uint32_t(lb), b + tail, n - tail) ^ 0xffffffffu;
+        out[2] = ExtendHardware(uint32_t(lc), c + tail, n - tail) ^ 0xffffffffu;
+      }
+#elif defined(SERIALISM_CRC32C_ARM)
+      inline bool HasHardware() {
+        return true;
+      }
+
+      inline uint32_t ExtendHardware(uint32_t l, const uint8_t* p, size_t n) {
+        while (n >= 8) {
+          uint64_t v;
+          std::memcpy(&v, p, sizeof(v));
+          l = __crc32cd(l, v);
+          p += 8;
+          n -= 8;
+        }
+        while (n--) {
+          l = __crc32cb(l, *p++);
+        }
+        return l;
+      }
+
+      inline void ExtendHardware3(
+        uint32_t* out, const uint8_t* a, const uint8_t* b, const uint8_t* c,
+        size_t n) {
+        out[0] = ExtendHardware(0xffffffffu, a, n) ^ 0xffffffffu;
+        out[1] = ExtendHardware(0xffffffffu, b, n) ^ 0xffffffffu;
+        out[2] = ExtendHardware(0xffffffffu, c, n) ^ 0xffffffffu;
+      }
+#else
+      inline bool HasHardware() {
+        return false;
+      }
+
+      inline uint32_t ExtendHardware(uint32_t l, const uint8_t* p, size_t n) {
+        return ExtendSoftware(l, p, n);
+      }
+
+      inline void ExtendHardware3(
+        uint32_t* out, const uint8_t* a, const uint8_t* b, const uint8_t* c,
+        size_t n) {
+        out[0] = ExtendSoftware(0xffffffffu, a, n) ^ 0xffffffffu;
+        out[1] = ExtendSoftware(0xffffffffu, b, n) ^ 0xffffffffu;
+        out[2] = ExtendSoftware(0xffffffffu, c, n) ^ 0xffffffffu;
+      }
+#endif
+    } // namespace detail
+
+    /**
+     * Extend a CRC32C value with `size` more bytes. Pass 0 to start a new one.
+     */
+    inline uint32_t Extend(uint32_t crc, const uint8_t* data, size_t size) {
+      uint32_t l = crc ^ 0xffffffffu;
+      l = detail::HasHardware() ? detail::ExtendHardware(l, data, size)
+                                : detail::ExtendSoftware(l, data, size);
+      return l ^ 0xffffffffu;
+    }
+
+    /**
+     * Compute the CRC32C of a byte range.
+     */
+    inline uint32_t Crc32c(const uint8_t* data, size_t size) {
+      return Extend(0, data, size);
+    }
+
+    /**
+     * Number of blocks needed to cover a payload of the given size.
+     */
+    inline uint32_t BlockCount(size_t payloadSize, uint32_t blockSize) {
+      return static_cast<uint32_t>((payloadSize + blockSize - 1) / blockSize);
+    }
+
+    /**
+     * Size in bytes of the trailer appended to a payload of the given size.
+     */
+    inline size_t TrailerSize(size_t payloadSize) {
+      return BlockCount(payloadSize, kBlockSize) * sizeof(uint32_t) +
+        kFooterSize;
+    }
+
+    /**
+     * Compute the checksum of every block in `data`, storing them in `out`.
+     */
+    inline void ComputeBlocks(
+      const uint8_t* data, size_t size, uint32_t blockSize, uint32_t* out) {
+      uint32_t count = BlockCount(size, blockSize);
+      uint32_t full = static_cast<uint32_t>(size / blockSize);
+      uint32_t i = 0;
+      if (detail::HasHardware()) {
+        for (; i + 3 <= full; i += 3) {
+          const uint8_t* p = data + size_t(i) * blockSize;
+          detail::ExtendHardware3(
+            out + i, p, p + blockSize, p + 2 * size_t(blockSize), blockSize);
+        }
+      }
+      for (; i < count; ++i) {
+        size_t offset = size_t(i) * blockSize;
+        size_t length = size - offset < blockSize ? size - offset : blockSize;
+        out[i] = Crc32c(data + offset, length);
+      }
+    }
+
+    /**
+     * Append the checksum trailer for the first `payloadSize` bytes of `data`.
+     * `data` must have room for `TrailerSize(payloadSize)` more bytes.
+     */
+    inline void WriteTrailer(uint8_t* data, size_t payloadSize) {
+      uint32_t count = BlockCount(payloadSize, kBlockSize);
+      uint8_t* out = data + payloadSize;
+      uint32_t crcs[3];
+      for (uint32_t i = 0; i < count; i += 3) {
+        size_t offset = size_t(i) * kBlockSize;
+        size_t length = payloadSize - offset;
+        uint32_t n = count - i < 3 ? count - i : 3;
+        ComputeBlocks(
+          data + offset,
+          length < size_t(n) * kBlockSize ? length : size_t(n) * kBlockSize,
+          kBlockSize,
+          crcs);
+        for (uint32_t k = 0; k < n; ++k) {
+          detail::Store32LE(out + (i + k) * sizeof(uint32_t), crcs[k]);
+        }
+      }
+      out += count * sizeof(uint32_t);
+      detail::Store32LE(out, kBlockSize);
+      detail::Store32LE(out + 4, count);
+      detail::Store32LE(out + 8, kTrailerMagic);
+    }
+
+    /**
+     * Locate and validate the trailer at the end of `data`.
+     */
+    inline Status ReadTrailer(const uint8_t* data, size_t size, Trailer* out) {
+      if (size < kFooterSize) {
+        return Status::kMissingTrailer;
+      }
+      const uint8_t* footer = data + size - kFooterSize;
+      if (detail::Load32LE(footer + 8) != kTrailerMagic) {
+        return Status::kMissingTrailer;
+      }
+      uint32_t blockSize = detail::Load32LE(footer);
+      uint32_t blockCount = detail::Load32LE(footer + 4);
+      size_t crcBytes = size_t(blockCount) * sizeof(uint32_t);
+      if (blockSize == 0 || crcBytes > size - kFooterSize) {
+        return Status::kMalformedTrailer;
+      }
+      size_t payloadSize = size - kFooterSize - crcBytes;
+      if (BlockCount(payloadSize, blockSize) != blockCount) {
+        return Status::kMalformedTrailer;
+      }
+      out->crcs = data + payloadSize;
+      out->payloadSize = payloadSize;
+      out->blockSize = blockSize;
+      out->blockCount = blockCount;
+      return Status::kOk;
+    }
+
+    /**
+     * Verify a single block of the payload against its stored checksum.
+     */
+    inline bool VerifyBlock(
+      const uint8_t* data, const Trailer& trailer, uint32_t index) {
+      size_t offset = size_t(index) * trailer.blockSize;
+      size_t length = trailer.payloadSize - offset;
+      if (length > trailer.blockSize) {
+        length = trailer.blockSize;
+      }
+      return Crc32c(data + offset, length) ==
+        detail::Load32LE(trailer.crcs + index * sizeof(uint32_t));
+    }
+
+    /**
+     * Verify every block of a checksummed payload. On a mismatch, the index
+     * of the first corrupted block is stored in `badBlock`.
+     */
+    inline Status Verify(
+      const uint8_t* data, size_t size, Trailer* trailer, uint32_t* badBlock) {
+      if (auto status = ReadTrailer(data, size, trailer);
+          status != Status::kOk) {
+        return status;
+      }
+      uint32_t crcs[3];
+      for (uint32_t i = 0; i < trailer->blockCount; i += 3) {
+        size_t offset = size_t(i) * trailer->blockSize;
+        size_t length = trailer->payloadSize - offset;
+        uint32_t n = trailer->blockCount - i < 3 ? trailer->blockCount - i : 3;
+        size_t span = size_t(n) * trailer->blockSize;
+        ComputeBlocks(
+          data + offset, length < span ? length : span, trailer->blockSize,
+          crcs);
+        for (uint32_t k = 0; k < n; ++k) {
+          if (
+            crcs[k] !=
+            detail::Load32LE(trailer->crcs + (i + k) * sizeof(uint32_t))) {
+            if (badBlock) {
+              *badBlock = i + k;
+            }
+            return Status::kMismatch;
+          }
+        }
+      }
+      return Status::kOk;
+    }
+  } // namespace checksum
+} // namespace serialism
+
+#endif // SERIALISM_CHECKSUM_H
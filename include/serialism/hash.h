@@ -0,0 +1,152 @@
+#ifndef SERIALISM_HASH_H
+#define SERIALISM_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Content fingerprints for serialized payloads.
+ *
+ * Fingerprints are XXH64 digests with a seed of zero, so they can be checked
+ * with any XXH64 implementation. `Hasher64` computes them incrementally,
+ * while a payload is being written.
+ */
+namespace serialism {
+  namespace hash {
+    namespace detail {
+      constexpr uint64_t kPrime1 = 0x9e3779b185ebca87ull;
+      constexpr uint64_t kPrime2 = 0xc2b2ae3d27d4eb4full;
+      constexpr uint64_t kPrime3 = 0x165667b19e3779f9ull;
+      constexpr uint64_t kPrime4 = 0x85ebca77c2b2ae63ull;
+      constexpr uint64_t kPrime5 = 0x27d4eb2f165667c5ull;
+
+      inline uint64_t Load64LE(const uint8_t* p) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        v = __builtin_bswap64(v);
+#endif
+        return v;
+      }
+
+      inline uint32_t Load32LE(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) |
+          (static_cast<uint32_t>(p[1]) << 8) |
+          (static_cast<uint32_t>(p[2]) << 16) |
+          (static_cast<uint32_t>(p[3]) << 24);
+      }
+
+      inline uint64_t Rotl(uint64_t v, int bits) {
+        return (v << bits) | (v >> (64 - bits));
+      }
+
+      inline uint64_t Round(uint64_t acc, uint64_t input) {
+        return Rotl(acc + input * kPrime2, 31) * kPrime1;
+      }
+
+      inline uint64_t MergeRound(uint64_t acc, uint64_t value) {
+        return (acc ^ Round(0, value)) * kPrime1 + kPrime4;
+      }
+    } // namespace detail
+
+    /**
+     * Computes the XXH64 digest of bytes given in any number of pieces.
+     */
+    class Hasher64 {
+        public:
+      explicit Hasher64(uint64_t seed = 0) {
+        _lanes[0] = seed + detail::kPrime1 + detail::kPrime2;
+        _lanes[1] = seed + detail::kPrime2;
+        _lanes[2] = seed;
+        _lanes[3] = seed - detail::kPrime1;
+        _seed = seed;
+      }
+
+      void Update(const uint8_t* data, size_t size) {
+        _total += size;
+        if (_buffered + size < sizeof(_buffer)) {
+          std::memcpy(_buffer + _buffered, data, size);
+          _buffered += size;
+          return;
+        }
+        if (_buffered) {
+          size_t fill = sizeof(_buffer) - _buffered;
+          std::memcpy(_buffer + _buffered, data, fill);
+          Consume(_buffer);
+          data += fill;
+          size -= fill;
+          _buffered = 0;
+        }
+        for (; size >= sizeof(_buffer); size -= sizeof(_buffer)) {
+          Consume(data);
+          data += sizeof(_buffer);
+        }
+        std::memcpy(_buffer, data, size);
+        _buffered = size;
+      }
+
+      /**
+       * The digest of the bytes given so far. More bytes may still be added.
+       */
+      uint64_t Digest() const {
+        using namespace detail;
+        uint64_t h;
+        if (_total >= sizeof(_buffer)) {
+          h = Rotl(_lanes[0], 1) + Rotl(_lanes[1], 7) + Rotl(_lanes[2], 12) +
+            Rotl(_lanes[3], 18);
+          for (uint64_t lane : _lanes) {
+            h = MergeRound(h, lane);
+          }
+        } else {
+          h = _seed + kPrime5;
+        }
+        h += _total;
+        const uint8_t* p = _buffer;
+        size_t n = _buffered;
+        for (; n >= 8; n -= 8, p += 8) {
+          h = Rotl(h ^ Round(0, Load64LE(p)), 27) * kPrime1 + kPrime4;
+        }
+        if (n >= 4) {
+          h = Rotl(h ^ (Load32LE(p) * kPrime1), 23) * kPrime2 + kPrime3;
+          n -= 4;
+          p += 4;
+        }
+        for (; n; --n) {
+          h = Rotl(h ^ (*p++ * kPrime5), 11) * kPrime1;
+        }
+        h ^= h >> 33;
+        h *= kPrime2;
+        h ^= h >> 29;
+        h *= kPrime3;
+        return h ^ (h >> 32);
+      }
+
+        private:
+      void Consume(const uint8_t* stripe) {
+        for (int i = 0; i < 4; ++i) {
+          _lanes[i] =
+            detail::Round(_lanes[i], detail::Load64LE(stripe + i * 8));
+        }
+      }
+
+      uint64_t _lanes[4];
+      uint64_t _seed;
+      uint64_t _total = 0;
+      uint8_t _buffer[32];
+      size_t _buffered = 0;
+    };
+
+    /**
+     * Compute the XXH64 digest of a byte range.
+     */
+    inline uint64_t Hash64(
+      const uint8_t* data, size_t size, uint64_t seed = 0) {
+      Hasher64 hasher(seed);
+      hasher.Update(data, size);
+      return hasher.Digest();
+    }
+  } // namespace hash
+} // namespace serialism
+
+#endif // SERIALISM_HASH_H
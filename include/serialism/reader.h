@@ -0,0 +1,868 @@
+#ifndef SERIALISM_READER_H
+#define SERIALISM_READER_H
+
+#include <serialism/wire.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace serialism {
+  namespace format {
+    enum class StringEncoding : uint8_t {
+      kLatin1 = 0, // One byte per character
+      kUtf8,       // UTF-8 bytes
+      kUtf16,      // Little-endian UTF-16 code units
+    };
+
+    /**
+     * A view over string data inside a payload. The data is not copied and
+     * is only valid for as long as the payload is.
+     */
+    struct StringView {
+      const uint8_t* data = nullptr;
+      size_t size = 0; // Size in bytes
+      StringEncoding encoding = StringEncoding::kLatin1;
+
+      /**
+       * Number of characters (UTF-16 code units for two-byte strings).
+       */
+      size_t length() const {
+        return encoding == StringEncoding::kUtf16 ? size / 2 : size;
+      }
+
+      /**
+       * Convert the string to UTF-8. Unpaired surrogates become U+FFFD.
+       */
+      std::string ToUtf8() const {
+        std::string out;
+        if (encoding == StringEncoding::kUtf8) {
+          out.assign(reinterpret_cast<const char*>(data), size);
+          return out;
+        }
+        out.reserve(size);
+        auto append = [&out](uint32_t c) {
+          if (c < 0x80) {
+            out.push_back(static_cast<char>(c));
+          } else if (c < 0x800) {
+            out.push_back(static_cast<char>(0xc0 | (c >> 6)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+          } else if (c < 0x10000) {
+            out.push_back(static_cast<char>(0xe0 | (c >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+          } else {
+            out.push_back(static_cast<char>(0xf0 | (c >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+          }
+        };
+        if (encoding == StringEncoding::kLatin1) {
+          for (size_t i = 0; i < size; ++i) {
+            append(data[i]);
+          }
+          return out;
+        }
+        size_t count = size / 2;
+        auto unit = [this](size_t i) -> uint32_t {
+          return data[2 * i] | (static_cast<uint32_t>(data[2 * i + 1]) << 8);
+        };
+        for (size_t i = 0; i < count; ++i) {
+          uint32_t c = unit(i);
+          if (c >= 0xd800 && c <= 0xdbff && i + 1 < count) {
+            uint32_t next = unit(i + 1);
+            if (next >= 0xdc00 && next <= 0xdfff) {
+              append(0x10000 + ((c - 0xd800) << 10) + (next - 0xdc00));
+              ++i;
+              continue;
+            }
+          }
+          append(c >= 0xd800 && c <= 0xdfff ? 0xfffd : c);
+        }
+        return out;
+      }
+    };
+
+    /**
+     * The little-endian 64-bit digits of a BigInt.
+     */
+    struct BigIntView {
+      bool negative = false;
+      const uint8_t* digits = nullptr;
+      size_t size = 0; // Size in bytes, a multiple of 8
+    };
+
+    /**
+     * How the class of a host object was recorded.
+     */
+    enum class HostClass : uint8_t {
+      kPlain = 0,     // Plain object (written as `undefined`)
+      kNullPrototype, // Object without a constructor (written as `null`)
+      kNamed,         // Instance of a registered class
+      kEntry,         // Instance of a class named by dictionary entry `uint32`
+    };
+
+    enum class TokenType : uint8_t {
+      kEnd = 0,    // The root value has been fully read
+      kUndefined,
+      kNull,
+      kHole,       // Missing element of a dense array
+      kTrue,
+      kFalse,
+      kInt32,
+      kUint32,
+      kDouble,
+      kBigInt,
+      kString,
+      kReference,  // Reference to the object with id `uint32`
+      kBeginObject,
+      kEndObject,
+      kBeginArray, // Dense or `sparse` array of `length` elements
+      kEndArray,
+      kBeginMap,
+      kEndMap,
+      kBeginSet,
+      kEndSet,
+      kDate,
+      kRegExp,
+      kBooleanObject,
+      kNumberObject,
+      kBigIntObject,
+      kStringObject,
+      kArrayBuffer,
+      kArrayBufferView, // A view over the array buffer read just before it
+      kBeginError,
+      kEndError,
+      kBeginHostObject,
+      kEndHostObject,
+      kSymbol,     // Global symbol key or value of a host object
+      kSelf,       // Reference to the enclosing host object
+      kEntry,      // Host object key that is shared dictionary entry `uint32`
+    };
+
+    /**
+     * A single event produced by `Reader::Next`.
+     *
+     * Objects and maps produce their entries as alternating key and value
+     * tokens, and so do host objects. Only the fields relevant to `type` are
+     * set; tokens that create an object carry its `id`, which later
+     * `kReference` tokens refer to.
+     */
+    struct Token {
+      TokenType type = TokenType::kEnd;
+      uint32_t id = 0;
+      bool boolean = false;
+      int32_t int32 = 0;
+      uint32_t uint32 = 0;
+      double number = 0;
+      // kString, kSymbol, kStringObject, kRegExp pattern, host class name,
+      // error message
+      StringView string;
+      StringView stack; // Error stack
+      BigIntView bigint;
+      // Array length, host property count, or the property count of an end
+      // token
+      uint32_t length = 0;
+      uint32_t flags = 0; // RegExp or array buffer view flags
+      bool sparse = false;
+      HostClass hostClass = HostClass::kPlain;
+      const uint8_t* bytes = nullptr; // Array buffer contents
+      size_t byteLength = 0;
+      size_t byteOffset = 0;
+      size_t maxByteLength = 0; // Resizable array buffers only
+      bool resizable = false;
+      wire::ArrayBufferViewTag viewType = wire::ArrayBufferViewTag::kDataView;
+      // Error prototype, `kEnd` for a plain `Error`
+      wire::ErrorTag errorPrototype = wire::ErrorTag::kEnd;
+      bool hasMessage = false;
+      bool hasStack = false;
+    };
+
+    /**
+     * Read the shared dictionary header a payload may start with. Returns
+     * its size, or 0 if the payload has none.
+     */
+    inline size_t ReadDictionaryHeader(
+      const uint8_t* data, size_t size, uint32_t* id) {
+      if (size == 0 || data[0] != wire::kDictionaryHeader) {
+        return 0;
+      }
+      uint32_t value = 0;
+      for (size_t i = 1; i < size && i <= 5; ++i) {
+        value |= static_cast<uint32_t>(data[i] & 0x7f) << (7 * (i - 1));
+        if (!(data[i] & 0x80)) {
+          *id = value;
+          return i + 1;
+        }
+      }
+      return 0;
+    }
+
+    /**
+     * A pull-style reader for serialism payloads that does not require V8.
+     *
+     * Nesting is tracked on an explicit stack, so arbitrarily deep payloads
+     * are read without recursion.
+     * @example
+     * ```cpp
+     * serialism::format::Reader reader(data, size);
+     * serialism::format::Token token;
+     * if (!reader.ReadHeader()) return;
+     * while (reader.Next(&token) && token.type != TokenType::kEnd) {
+     *   if (token.type == TokenType::kBeginHostObject) ...
+     * }
+     * if (reader.error()) std::cerr << reader.error();
+     * ```
+     */
+    class Reader {
+        public:
+      Reader(const uint8_t* data, size_t size):
+        _data(data), _end(data + size), _pos(data) {}
+
+      /**
+       * Read and validate the payload header.
+       */
+      bool ReadHeader() {
+        size_t dictionary =
+          ReadDictionaryHeader(_pos, _end - _pos, &_dictionary);
+        _hasDictionary = dictionary != 0;
+        _pos += dictionary;
+        SkipPadding();
+        uint8_t tag;
+        if (
+          !ReadByte(&tag) ||
+          tag != static_cast<uint8_t>(wire::Tag::kVersion)) {
+          return Fail("Missing version header");
+        }
+        if (!ReadVarint(&_version)) {
+          return false;
+        }
+        if (
+          _version < wire::kMinimumVersion ||
+          _version > wire::kLatestVersion) {
+          return Fail("Unsupported format version");
+        }
+        return true;
+      }
+
+      /**
+       * Read the next token. Returns false if the payload is malformed, in
+       * which case `error()` describes the problem.
+       */
+      bool Next(Token* token) {
+        if (_error) {
+          return false;
+        }
+        *token = Token();
+        if (_pendingView) {
+          _pendingView = false;
+          return ReadArrayBufferView(token);
+        }
+        if (_stack.empty()) {
+          if (_rootRead) {
+            token->type = TokenType::kEnd;
+            return true;
+          }
+          _rootRead = true;
+          return ReadValue(token);
+        }
+        Frame& frame = _stack.back();
+        switch (frame.kind) {
+          case FrameKind::kHost: return NextInHostObject(frame, token);
+          case FrameKind::kError: return NextInError(frame, token);
+          default: break;
+        }
+        SkipPadding();
+        if (_pos >= _end) {
+          return Fail("Unexpected end of data");
+        }
+        auto tag = static_cast<wire::Tag>(*_pos);
+        switch (frame.kind) {
+          case FrameKind::kObject:
+            if (tag != wire::Tag::kEndJSObject) {
+              break;
+            }
+            ++_pos;
+            token->type = TokenType::kEndObject;
+            token->id = frame.id;
+            _stack.pop_back();
+            return ReadVarint(&token->length);
+          case FrameKind::kDenseArray:
+          case FrameKind::kSparseArray:
+            if (
+              tag !=
+              (frame.kind == FrameKind::kDenseArray
+                 ? wire::Tag::kEndDenseJSArray
+                 : wire::Tag::kEndSparseJSArray)) {
+              break;
+            }
+            ++_pos;
+            token->type = TokenType::kEndArray;
+            token->id = frame.id;
+            token->sparse = frame.kind == FrameKind::kSparseArray;
+            _stack.pop_back();
+            return ReadVarint(&token->length) && ReadVarint(&token->uint32);
+          case FrameKind::kMap:
+          case FrameKind::kSet:
+            if (
+              tag !=
+              (frame.kind == FrameKind::kMap ? wire::Tag::kEndJSMap
+                                             : wire::Tag::kEndJSSet)) {
+              break;
+            }
+            ++_pos;
+            token->type = frame.kind == FrameKind::kMap ? TokenType::kEndMap
+                                                        : TokenType::kEndSet;
+            token->id = frame.id;
+            _stack.pop_back();
+            return ReadVarint(&token->length);
+          default: break;
+        }
+        return ReadValue(token);
+      }
+
+      /**
+       * A description of the first error encountered, or null.
+       */
+      const char* error() const {
+        return _error;
+      }
+
+      uint32_t version() const {
+        return _version;
+      }
+
+      /**
+       * Whether the payload was written with a shared dictionary, whose id
+       * is then given by `dictionary()`. Host object keys and class names
+       * refer to its entries by index, which the caller must resolve.
+       */
+      bool hasDictionary() const {
+        return _hasDictionary;
+      }
+
+      uint32_t dictionary() const {
+        return _dictionary;
+      }
+
+      /**
+       * Offset of the next unread byte.
+       */
+      size_t position() const {
+        return static_cast<size_t>(_pos - _data);
+      }
+
+      /**
+       * Whether the array buffer (or reference to one) just read is followed
+       * by a view over it, in which case the view is the actual value.
+       */
+      bool viewFollows() const {
+        return _pendingView;
+      }
+
+      /**
+       * Number of containers currently open.
+       */
+      size_t depth() const {
+        return _stack.size();
+      }
+
+        private:
+      enum class FrameKind : uint8_t {
+        kObject,
+        kDenseArray,
+        kSparseArray,
+        kMap,
+        kSet,
+        kError,
+        kHost,
+      };
+
+      struct Frame {
+        FrameKind kind;
+        bool expectValue; // Host objects: a value follows. Errors: a cause.
+        uint32_t remaining; // Host objects: properties left to read
+        uint32_t id;
+      };
+
+      bool Fail(const char* message) {
+        if (!_error) {
+          _error = message;
+        }
+        return false;
+      }
+
+      void SkipPadding() {
+        while (
+          _pos < _end && *_pos == static_cast<uint8_t>(wire::Tag::kPadding)) {
+          ++_pos;
+        }
+      }
+
+      bool ReadByte(uint8_t* out) {
+        if (_pos >= _end) {
+          return Fail("Unexpected end of data");
+        }
+        *out = *_pos++;
+        return true;
+      }
+
+      template <typename T>
+      bool ReadVarint(T* out) {
+        T value = 0;
+        unsigned shift = 0;
+        while (true) {
+          if (_pos >= _end) {
+            return Fail("Unexpected end of data");
+          }
+          uint8_t byte = *_pos++;
+          if (shift < sizeof(T) * 8) {
+            value |= static_cast<T>(byte & 0x7f) << shift;
+          }
+          shift += 7;
+          if (!(byte & 0x80)) {
+            break;
+          }
+          if (shift > sizeof(T) * 8 + 7) {
+            return Fail("Varint is too long");
+          }
+        }
+        *out = value;
+        return true;
+      }
+
+      bool ReadDoubleValue(double* out) {
+        if (static_cast<size_t>(_end - _pos) < sizeof(double)) {
+          return Fail("Unexpected end of data");
+        }
+        std::memcpy(out, _pos, sizeof(double));
+        _pos += sizeof(double);
+        return true;
+      }
+
+      bool ReadBytes(size_t size, const uint8_t** out) {
+        if (static_cast<size_t>(_end - _pos) < size) {
+          return Fail("Unexpected end of data");
+        }
+        *out = _pos;
+        _pos += size;
+        return true;
+      }
+
+      bool ReadStringContents(wire::Tag tag, StringView* out) {
+        uint32_t size;
+        if (!ReadVarint(&size) || !ReadBytes(size, &out->data)) {
+          return false;
+        }
+        out->size = size;
+        switch (tag) {
+          case wire::Tag::kOneByteString:
+            out->encoding = StringEncoding::kLatin1;
+            return true;
+          case wire::Tag::kTwoByteString:
+            out->encoding = StringEncoding::kUtf16;
+            return size % 2 == 0 || Fail("Invalid two-byte string length");
+          case wire::Tag::kUtf8String:
+            out->encoding = StringEncoding::kUtf8;
+            return true;
+          default: return Fail("Expected a string");
+        }
+      }
+
+      bool ReadString(StringView* out) {
+        SkipPadding();
+        uint8_t tag;
+        return ReadByte(&tag) &&
+          ReadStringContents(static_cast<wire::Tag>(tag), out);
+      }
+
+      bool ReadBigIntContents(BigIntView* out) {
+        uint32_t bitfield;
+        if (!ReadVarint(&bitfield)) {
+          return false;
+        }
+        out->negative = bitfield & 1;
+        out->size = bitfield >> 1;
+        if (out->size % 8 != 0) {
+          return Fail("Invalid BigInt length");
+        }
+        return ReadBytes(out->size, &out->digits);
+      }
+
+      uint32_t NewId(bool isArrayBuffer = false) {
+        _arrayBuffers.push_back(isArrayBuffer);
+        return static_cast<uint32_t>(_arrayBuffers.size() - 1);
+      }
+
+      void Push(FrameKind kind, uint32_t id, uint32_t remaining = 0) {
+        _stack.push_back(Frame {kind, false, remaining, id});
+      }
+
+      // An array buffer may be followed by a view over it.
+      void CheckArrayBufferView() {
+        SkipPadding();
+        _pendingView = _pos < _end &&
+          *_pos == static_cast<uint8_t>(wire::Tag::kArrayBufferView);
+      }
+
+      bool ReadArrayBufferView(Token* token) {
+        ++_pos; // kArrayBufferView
+        uint8_t subtag;
+        uint32_t offset, length;
+        if (
+          !ReadByte(&subtag) || !ReadVarint(&offset) || !ReadVarint(&length)) {
+          return false;
+        }
+        if (_version >= 14 && !ReadVarint(&token->flags)) {
+          return false;
+        }
+        token->type = TokenType::kArrayBufferView;
+        token->id = NewId();
+        token->viewType = static_cast<wire::ArrayBufferViewTag>(subtag);
+        token->byteOffset = offset;
+        token->byteLength = length;
+        return true;
+      }
+
+      bool ReadError(Token* token) {
+        token->type = TokenType::kBeginError;
+        token->id = NewId();
+        Push(FrameKind::kError, token->id);
+        return ReadErrorFields(token);
+      }
+
+      // Read error subtags up to and including a cause or end marker.
+      bool ReadErrorFields(Token* token) {
+        while (true) {
+          uint8_t tag;
+          if (!ReadByte(&tag)) {
+            return false;
+          }
+          switch (static_cast<wire::ErrorTag>(tag)) {
+            case wire::ErrorTag::kEvalErrorPrototype:
+            case wire::ErrorTag::kRangeErrorPrototype:
+            case wire::ErrorTag::kReferenceErrorPrototype:
+            case wire::ErrorTag::kSyntaxErrorPrototype:
+            case wire::ErrorTag::kTypeErrorPrototype:
+            case wire::ErrorTag::kUriErrorPrototype:
+              token->errorPrototype = static_cast<wire::ErrorTag>(tag);
+              break;
+            case wire::ErrorTag::kMessage:
+              if (!ReadString(&token->string)) {
+                return false;
+              }
+              token->hasMessage = true;
+              break;
+            case wire::ErrorTag::kStack:
+              if (!ReadString(&token->stack)) {
+                return false;
+              }
+              token->hasStack = true;
+              break;
+            case wire::ErrorTag::kCause:
+              _stack.back().expectValue = true;
+              return true;
+            case wire::ErrorTag::kEnd: return true;
+            default: return Fail("Unknown error tag");
+          }
+        }
+      }
+
+      bool NextInError(Frame& frame, Token* token) {
+        if (frame.expectValue) {
+          frame.expectValue = false;
+          return ReadValue(token); // The cause
+        }
+        // Either the end marker or the fields following a cause remain.
+        token->type = TokenType::kEndError;
+        token->id = frame.id;
+        size_t index = _stack.size() - 1;
+        if (!ReadErrorFields(token)) {
+          return false;
+        }
+        if (_stack[index].expectValue) {
+          return Fail("Error has more than one cause");
+        }
+        _stack.pop_back();
+        return true;
+      }
+
+      bool NextInHostObject(Frame& frame, Token* token) {
+        if (frame.expectValue) {
+          frame.expectValue = false;
+          uint32_t kind;
+          if (!ReadVarint(&kind)) {
+            return false;
+          }
+          switch (kind) {
+            case wire::vSelf:
+              token->type = TokenType::kSelf;
+              token->id = frame.id;
+              return true;
+            case wire::vSymbol:
+              token->type = TokenType::kSymbol;
+              return ReadString(&token->string);
+            case wire::vValue: return ReadValue(token);
+            default: return Fail("Unknown value kind");
+          }
+        }
+        if (frame.remaining == 0) {
+          token->type = TokenType::kEndHostObject;
+          token->id = frame.id;
+          _stack.pop_back();
+          return true;
+        }
+        --frame.remaining;
+        frame.expectValue = true;
+        uint32_t kind;
+        if (!ReadVarint(&kind)) {
+          return false;
+        }
+        switch (kind) {
+          case wire::kSymbol:
+            token->type = TokenType::kSymbol;
+            return ReadString(&token->string);
+          case wire::kString:
+          case wire::kNumber:
+            if (!ReadValue(token)) {
+              return false;
+            }
+            if (
+              token->type != TokenType::kString &&
+              token->type != TokenType::kInt32 &&
+              token->type != TokenType::kUint32 &&
+              token->type != TokenType::kDouble) {
+              return Fail("Invalid host object key");
+            }
+            return true;
+          case wire::kEntry:
+            if (!_hasDictionary) {
+              return Fail("Dictionary entry without a dictionary");
+            }
+            token->type = TokenType::kEntry;
+            return ReadVarint(&token->uint32);
+          default: return Fail("Unknown key kind");
+        }
+      }
+
+      bool ReadHostObject(Token* token) {
+        token->type = TokenType::kBeginHostObject;
+        token->id = NewId();
+        SkipPadding();
+        uint8_t tag;
+        if (!ReadByte(&tag)) {
+          return false;
+        }
+        switch (static_cast<wire::Tag>(tag)) {
+          case wire::Tag::kUndefined:
+            token->hostClass = HostClass::kPlain;
+            break;
+          case wire::Tag::kNull:
+            token->hostClass = HostClass::kNullPrototype;
+            break;
+          case wire::Tag::kInt32:
+            {
+              uint32_t zigzag;
+              if (!_hasDictionary) {
+                return Fail("Dictionary entry without a dictionary");
+              }
+              if (!ReadVarint(&zigzag)) {
+                return false;
+              }
+              if (zigzag & 1) {
+                return Fail("Invalid dictionary entry");
+              }
+              token->hostClass = HostClass::kEntry;
+              token->uint32 = zigzag >> 1;
+              break;
+            }
+          default:
+            token->hostClass = HostClass::kNamed;
+            if (!ReadStringContents(
+                  static_cast<wire::Tag>(tag), &token->string)) {
+              return false;
+            }
+        }
+        if (!ReadVarint(&token->length)) {
+          return false;
+        }
+        Push(FrameKind::kHost, token->id, token->length);
+        return true;
+      }
+
+      bool ReadValue(Token* token) {
+        while (true) {
+          SkipPadding();
+          uint8_t byte;
+          if (!ReadByte(&byte)) {
+            return false;
+          }
+          auto tag = static_cast<wire::Tag>(byte);
+          switch (tag) {
+            case wire::Tag::kVerifyObjectCount:
+              {
+                uint32_t ignored;
+                if (!ReadVarint(&ignored)) {
+                  return false;
+                }
+                continue;
+              }
+            case wire::Tag::kUndefined:
+              token->type = TokenType::kUndefined;
+              return true;
+            case wire::Tag::kNull: token->type = TokenType::kNull; return true;
+            case wire::Tag::kTrue: token->type = TokenType::kTrue; return true;
+            case wire::Tag::kFalse:
+              token->type = TokenType::kFalse;
+              return true;
+            case wire::Tag::kTheHole:
+              if (
+                _stack.empty() ||
+                _stack.back().kind != FrameKind::kDenseArray) {
+                return Fail("Unexpected hole");
+              }
+              token->type = TokenType::kHole;
+              return true;
+            case wire::Tag::kInt32:
+              {
+                uint32_t zigzag;
+                if (!ReadVarint(&zigzag)) {
+                  return false;
+                }
+                token->type = TokenType::kInt32;
+                token->int32 =
+                  static_cast<int32_t>((zigzag >> 1) ^ -(zigzag & 1));
+                return true;
+              }
+            case wire::Tag::kUint32:
+              token->type = TokenType::kUint32;
+              return ReadVarint(&token->uint32);
+            case wire::Tag::kDouble:
+              token->type = TokenType::kDouble;
+              return ReadDoubleValue(&token->number);
+            case wire::Tag::kBigInt:
+              token->type = TokenType::kBigInt;
+              return ReadBigIntContents(&token->bigint);
+            case wire::Tag::kUtf8String:
+            case wire::Tag::kOneByteString:
+            case wire::Tag::kTwoByteString:
+              token->type = TokenType::kString;
+              return ReadStringContents(tag, &token->string);
+            case wire::Tag::kObjectReference:
+              {
+                token->type = TokenType::kReference;
+                if (!ReadVarint(&token->uint32)) {
+                  return false;
+                }
+                if (token->uint32 >= _arrayBuffers.size()) {
+                  return Fail("Invalid object reference");
+                }
+                if (_arrayBuffers[token->uint32]) {
+                  CheckArrayBufferView();
+                }
+                return true;
+              }
+            case wire::Tag::kBeginJSObject:
+              token->type = TokenType::kBeginObject;
+              token->id = NewId();
+              Push(FrameKind::kObject, token->id);
+              return true;
+            case wire::Tag::kBeginDenseJSArray:
+            case wire::Tag::kBeginSparseJSArray:
+              token->type = TokenType::kBeginArray;
+              token->id = NewId();
+              token->sparse = tag == wire::Tag::kBeginSparseJSArray;
+              Push(
+                token->sparse ? FrameKind::kSparseArray
+                              : FrameKind::kDenseArray,
+                token->id);
+              return ReadVarint(&token->length);
+            case wire::Tag::kDate:
+              token->type = TokenType::kDate;
+              token->id = NewId();
+              return ReadDoubleValue(&token->number);
+            case wire::Tag::kTrueObject:
+            case wire::Tag::kFalseObject:
+              token->type = TokenType::kBooleanObject;
+              token->id = NewId();
+              token->boolean = tag == wire::Tag::kTrueObject;
+              return true;
+            case wire::Tag::kNumberObject:
+              token->type = TokenType::kNumberObject;
+              token->id = NewId();
+              return ReadDoubleValue(&token->number);
+            case wire::Tag::kBigIntObject:
+              token->type = TokenType::kBigIntObject;
+              token->id = NewId();
+              return ReadBigIntContents(&token->bigint);
+            case wire::Tag::kStringObject:
+              token->type = TokenType::kStringObject;
+              token->id = NewId();
+              return ReadString(&token->string);
+            case wire::Tag::kRegExp:
+              token->type = TokenType::kRegExp;
+              token->id = NewId();
+              return ReadString(&token->string) && ReadVarint(&token->flags);
+            case wire::Tag::kBeginJSMap:
+              token->type = TokenType::kBeginMap;
+              token->id = NewId();
+              Push(FrameKind::kMap, token->id);
+              return true;
+            case wire::Tag::kBeginJSSet:
+              token->type = TokenType::kBeginSet;
+              token->id = NewId();
+              Push(FrameKind::kSet, token->id);
+              return true;
+            case wire::Tag::kArrayBuffer:
+            case wire::Tag::kResizableArrayBuffer:
+              {
+                uint32_t size, maxSize = 0;
+                if (!ReadVarint(&size)) {
+                  return false;
+                }
+                if (tag == wire::Tag::kResizableArrayBuffer) {
+                  if (!ReadVarint(&maxSize)) {
+                    return false;
+                  }
+                  if (size > maxSize) {
+                    return Fail("Resizable array buffer exceeds its maximum");
+                  }
+                }
+                token->type = TokenType::kArrayBuffer;
+                token->id = NewId(true);
+                token->byteLength = size;
+                token->maxByteLength = maxSize;
+                token->resizable = tag == wire::Tag::kResizableArrayBuffer;
+                if (!ReadBytes(size, &token->bytes)) {
+                  return false;
+                }
+                CheckArrayBufferView();
+                return true;
+              }
+            case wire::Tag::kError: return ReadError(token);
+            case wire::Tag::kHostObject: return ReadHostObject(token);
+            default: return Fail("Unexpected or unsupported tag");
+          }
+        }
+      }
+
+      const uint8_t* _data;
+      const uint8_t* _end;
+      const uint8_t* _pos;
+      const char* _error = nullptr;
+      uint32_t _version = 0;
+      bool _hasDictionary = false;
+      uint32_t _dictionary = 0;
+      bool _rootRead = false;
+      bool _pendingView = false;
+      std::vector<Frame> _stack;
+      // Whether the object with a given id is an array buffer
+      std::vector<bool> _arrayBuffers;
+    };
+  } // namespace format
+} // namespace serialism
+
+#endif // SERIALISM_READER_H
@@ -0,0 +1,131 @@
+#ifndef SERIALISM_WIRE_H
+#define SERIALISM_WIRE_H
+
+#include <cstdint>
+
+/**
+ * Constants describing the serialism wire format.
+ *
+ * A payload is a V8 `ValueSerializer` stream. Registered class instances and
+ * objects with symbol keys or values are written as V8 host objects, whose
+ * contents are defined by serialism:
+ *
+ *   '\' <class name: string | undefined | null | int32>
+ *     <property count: varint>
+ *     (<CustomHostKeyKind: varint> <key>
+ *      <CustomHostValueKind: varint> [value])*
+ *
+ * Keys are a string or number value, the description string of a global
+ * symbol, or the index (a varint) of a shared dictionary entry. Values are a
+ * regular value, the description string of a global symbol, or nothing at
+ * all for a reference to the host object itself.
+ *
+ * A payload written with a shared dictionary starts with
+ * `kDictionaryHeader` and the dictionary id (a varint) ahead of the version
+ * header. Its class names may then also be the int32 index of an entry.
+ */
+namespace serialism {
+  namespace wire {
+    constexpr uint32_t kLatestVersion = 15;
+    constexpr uint32_t kMinimumVersion = 13;
+
+    // First byte of a payload written with a shared dictionary.
+    constexpr uint8_t kDictionaryHeader = 0xFE;
+
+    enum class Tag : uint8_t {
+      kVersion = 0xFF,
+      kPadding = '\0',
+      kVerifyObjectCount = '?',
+      kTheHole = '-',
+      kUndefined = '_',
+      kNull = '0',
+      kTrue = 'T',
+      kFalse = 'F',
+      kInt32 = 'I',
+      kUint32 = 'U',
+      kDouble = 'N',
+      kBigInt = 'Z',
+      kUtf8String = 'S',
+      kOneByteString = '"',
+      kTwoByteString = 'c',
+      kObjectReference = '^',
+      kBeginJSObject = 'o',
+      kEndJSObject = '{',
+      kBeginSparseJSArray = 'a',
+      kEndSparseJSArray = '@',
+      kBeginDenseJSArray = 'A',
+      kEndDenseJSArray = '$',
+      kDate = 'D',
+      kTrueObject = 'y',
+      kFalseObject = 'x',
+      kNumberObject = 'n',
+      kBigIntObject = 'z',
+      kStringObject = 's',
+      kRegExp = 'R',
+      kBeginJSMap = ';',
+      kEndJSMap = ':',
+      kBeginJSSet = '\'',
+      kEndJSSet = ',',
+      kArrayBuffer = 'B',
+      kResizableArrayBuffer = '~',
+      kArrayBufferTransfer = 't',
+      kArrayBufferView = 'V',
+      kSharedArrayBuffer = 'u',
+      kSharedObject = 'p',
+      kWasmModuleTransfer = 'w',
+      kHostObject = '\\',
+      kWasmMemoryTransfer = 'm',
+      kError = 'r',
+    };
+
+    enum class ArrayBufferViewTag : uint8_t {
+      kInt8Array = 'b',
+      kUint8Array = 'B',
+      kUint8ClampedArray = 'C',
+      kInt16Array = 'w',
+      kUint16Array = 'W',
+      kInt32Array = 'd',
+      kUint32Array = 'D',
+      kFloat16Array = 'h',
+      kFloat32Array = 'f',
+      kFloat64Array = 'F',
+      kBigInt64Array = 'q',
+      kBigUint64Array = 'Q',
+      kDataView = '?',
+    };
+
+    // Flags of an array buffer view, from format version 14.
+    enum ArrayBufferViewFlags : uint32_t {
+      kIsLengthTracking = 1,
+      kIsBackedByRab = 2, // The buffer is resizable
+    };
+
+    enum class ErrorTag : uint8_t {
+      kEvalErrorPrototype = 'E',
+      kRangeErrorPrototype = 'R',
+      kReferenceErrorPrototype = 'F',
+      kSyntaxErrorPrototype = 'S',
+      kTypeErrorPrototype = 'T',
+      kUriErrorPrototype = 'U',
+      kMessage = 'm',
+      kCause = 'c',
+      kStack = 's',
+      kEnd = '.',
+    };
+
+    enum CustomHostKeyKind : uint32_t {
+      kString = 0, // String key
+      kSymbol,     // Symbol key
+      kNumber,     // Number key
+      kEntry,      // Shared dictionary entry
+    };
+
+    enum CustomHostValueKind : uint32_t {
+      vValue = 0, // Regular value
+      vSymbol,    // Symbol value
+      vSelf,      // Self-reference
+    };
+  } // namespace wire
+} // namespace serialism
+
+#endif // SERIALISM_WIRE_H
@@ -0,0 +1,886 @@
+#ifndef SERIALISM_WRITER_H
+#define SERIALISM_WRITER_H
+
+#include <serialism/hash.h>
+#include <serialism/reader.h>
+#include <serialism/wire.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace serialism {
+  namespace format {
+    /**
+     * A growable output buffer allocated with `malloc`, so that released
+     * memory can be handed to anything expecting to `free` it.
+     */
+    class BufferSink {
+        public:
+      BufferSink() = default;
+      BufferSink(const BufferSink&) = delete;
+      BufferSink& operator=(const BufferSink&) = delete;
+      BufferSink(BufferSink&& other) noexcept {
+        *this = std::move(other);
+      }
+      BufferSink& operator=(BufferSink&& other) noexcept {
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+        std::swap(_capacity, other._capacity);
+        std::swap(_failed, other._failed);
+        return *this;
+      }
+      ~BufferSink() {
+        free(_data);
+      }
+
+      /**
+       * Append `size` bytes and return a pointer to them, or null if the
+       * buffer could not grow. The pointer is valid until the next append.
+       */
+      uint8_t* Append(size_t size) {
+        if (_capacity - _size < size && !Grow(size)) {
+          return nullptr;
+        }
+        uint8_t* out = _data + _size;
+        _size += size;
+        return out;
+      }
+
+      void Write(const void* data, size_t size) {
+        if (uint8_t* out = Append(size)) {
+          std::memcpy(out, data, size);
+        }
+      }
+
+      void Put(uint8_t byte) {
+        if (_size < _capacity || Grow(1)) {
+          _data[_size++] = byte;
+        }
+      }
+
+      size_t size() const {
+        return _size;
+      }
+
+      const uint8_t* data() const {
+        return _data;
+      }
+
+      bool failed() const {
+        return _failed;
+      }
+
+      /**
+       * Transfer ownership of the buffer to the caller, who must `free` it.
+       */
+      std::pair<uint8_t*, size_t> Release() {
+        std::pair<uint8_t*, size_t> result(_data, _size);
+        _data = nullptr;
+        _size = _capacity = 0;
+        return result;
+      }
+
+        private:
+      bool Grow(size_t needed) {
+        if (_failed) {
+          return false;
+        }
+        size_t capacity = _capacity ? _capacity * 2 : 64;
+        while (capacity - _size < needed) {
+          capacity *= 2;
+        }
+        auto data = static_cast<uint8_t*>(realloc(_data, capacity));
+        if (!data) {
+          _failed = true;
+          return false;
+        }
+        _data = data;
+        _capacity = capacity;
+        return true;
+      }
+
+      uint8_t* _data = nullptr;
+      size_t _size = 0;
+      size_t _capacity = 0;
+      bool _failed = false;
+    };
+
+    /**
+     * Counts the bytes written without storing them, to measure a payload
+     * before producing it. `Append` returns null, so space reserved for
+     * strings is never filled in.
+     */
+    class CountingSink {
+        public:
+      uint8_t* Append(size_t size) {
+        _size += size;
+        return nullptr;
+      }
+
+      void Write(const void* /* data */, size_t size) {
+        _size += size;
+      }
+
+      void Put(uint8_t /* byte */) {
+        ++_size;
+      }
+
+      size_t size() const {
+        return _size;
+      }
+
+      bool failed() const {
+        return false;
+      }
+
+        private:
+      size_t _size = 0;
+    };
+
+    /**
+     * A `BufferSink` that also computes the XXH64 digest of its contents,
+     * hashing them in chunks shortly after they are written, while they are
+     * still in cache.
+     */
+    class HashingSink {
+        public:
+      static constexpr size_t kChunkSize = 4096;
+
+      uint8_t* Append(size_t size) {
+        // Space handed out earlier has been filled in by now.
+        if (_buffer.size() - _hashed >= kChunkSize) {
+          HashWritten();
+        }
+        return _buffer.Append(size);
+      }
+
+      void Write(const void* data, size_t size) {
+        if (uint8_t* out = Append(size)) {
+          std::memcpy(out, data, size);
+        }
+      }
+
+      void Put(uint8_t byte) {
+        if (_buffer.size() - _hashed >= kChunkSize) {
+          HashWritten();
+        }
+        _buffer.Put(byte);
+      }
+
+      size_t size() const {
+        return _buffer.size();
+      }
+
+      const uint8_t* data() const {
+        return _buffer.data();
+      }
+
+      bool failed() const {
+        return _buffer.failed();
+      }
+
+      /**
+       * The digest of everything written. Call once writing is done.
+       */
+      uint64_t Digest() {
+        HashWritten();
+        return _hasher.Digest();
+      }
+
+      /**
+       * Transfer ownership of the buffer to the caller, who must `free` it.
+       */
+      std::pair<uint8_t*, size_t> Release() {
+        HashWritten();
+        return _buffer.Release();
+      }
+
+        private:
+      void HashWritten() {
+        if (_buffer.size() > _hashed && !_buffer.failed()) {
+          _hasher.Update(_buffer.data() + _hashed, _buffer.size() - _hashed);
+        }
+        _hashed = _buffer.size();
+      }
+
+      BufferSink _buffer;
+      hash::Hasher64 _hasher;
+      size_t _hashed = 0;
+    };
+
+    /**
+     * Writes serialism payloads without V8. The output can be read with
+     * `Serialism#deserialize` or `Reader`.
+     *
+     * Containers are opened and closed explicitly, and the writer counts the
+     * entries written to each of them. Inside a host object, keys and values
+     * alternate and are tagged with their serialism key or value kind
+     * automatically. Methods that create an object return its id, for use
+     * with `WriteReference`.
+     * @example
+     * ```cpp
+     * serialism::format::Writer writer;
+     * writer.WriteHeader();
+     * writer.BeginHostObject(HostClass::kNamed, "Point", 2);
+     * writer.WriteString("x");
+     * writer.WriteInt32(1);
+     * writer.WriteString("y");
+     * writer.WriteInt32(2);
+     * writer.EndHostObject();
+     * auto [data, size] = writer.sink().Release();
+     * ```
+     */
+    template <typename Sink>
+    class BasicWriter {
+        public:
+      explicit BasicWriter(Sink sink = Sink()): _sink(std::move(sink)) {}
+
+      Sink& sink() {
+        return _sink;
+      }
+
+      /**
+       * False if the writer was misused or the sink failed to allocate.
+       */
+      bool ok() const {
+        return !_error && !_sink.failed();
+      }
+
+      const char* error() const {
+        return _error;
+      }
+
+      /**
+       * The id that will be assigned to the next object written.
+       */
+      uint32_t nextId() const {
+        return _nextId;
+      }
+
+      void WriteHeader() {
+        PutTag(wire::Tag::kVersion);
+        PutVarint(wire::kLatestVersion);
+      }
+
+      /**
+       * Write the header of a payload whose host object keys and class names
+       * may refer to the entries of the shared dictionary `dictionary`.
+       */
+      void WriteHeader(uint32_t dictionary) {
+        _sink.Put(wire::kDictionaryHeader);
+        PutVarint(dictionary);
+        _dictionary = true;
+        WriteHeader();
+      }
+
+      void WriteUndefined() {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kUndefined);
+      }
+
+      void WriteNull() {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kNull);
+      }
+
+      void WriteBoolean(bool value) {
+        Prepare(Slot::kOther);
+        PutTag(value ? wire::Tag::kTrue : wire::Tag::kFalse);
+      }
+
+      void WriteInt32(int32_t value) {
+        Prepare(Slot::kNumber);
+        PutTag(wire::Tag::kInt32);
+        PutVarint(
+          (static_cast<uint32_t>(value) << 1) ^
+          static_cast<uint32_t>(value >> 31));
+      }
+
+      void WriteUint32(uint32_t value) {
+        Prepare(Slot::kNumber);
+        PutTag(wire::Tag::kUint32);
+        PutVarint(value);
+      }
+
+      void WriteDouble(double value) {
+        Prepare(Slot::kNumber);
+        PutTag(wire::Tag::kDouble);
+        _sink.Write(&value, sizeof(value));
+      }
+
+      /**
+       * Write a number using the most compact encoding that preserves it.
+       */
+      void WriteNumber(double value) {
+        if (
+          value >= -2147483648.0 && value <= 2147483647.0 &&
+          value == static_cast<int32_t>(value) &&
+          !(value == 0 && std::signbit(value))) {
+          WriteInt32(static_cast<int32_t>(value));
+        } else {
+          WriteDouble(value);
+        }
+      }
+
+      /**
+       * Write a BigInt from its little-endian 64-bit digits.
+       */
+      void WriteBigInt(bool negative, const uint8_t* digits, size_t size) {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kBigInt);
+        PutBigIntContents(negative, digits, size);
+      }
+
+      void WriteOneByteString(const uint8_t* chars, size_t length) {
+        Prepare(Slot::kString);
+        PutOneByteString(chars, length);
+      }
+
+      void WriteTwoByteString(const uint16_t* chars, size_t length) {
+        Prepare(Slot::kString);
+        PutTwoByteString(chars, length);
+      }
+
+      /**
+       * Write the header of a one-byte string of `length` characters and
+       * return where the characters go, so they can be produced in place.
+       * Null if the sink could not grow or does not keep its contents.
+       */
+      uint8_t* ReserveOneByteString(size_t length) {
+        Prepare(Slot::kString);
+        PutTag(wire::Tag::kOneByteString);
+        PutVarint(static_cast<uint32_t>(length));
+        return _sink.Append(length);
+      }
+
+      /**
+       * Like `ReserveOneByteString`, for `length` UTF-16 code units. The
+       * returned pointer is at an even offset into the output.
+       */
+      uint8_t* ReserveTwoByteString(size_t length) {
+        Prepare(Slot::kString);
+        PutTwoByteHeader(static_cast<uint32_t>(length * 2));
+        return _sink.Append(length * 2);
+      }
+
+      /**
+       * Write a UTF-8 string.
+       */
+      void WriteString(std::string_view value) {
+        Prepare(Slot::kString);
+        PutString(value);
+      }
+
+      /**
+       * Write a string as it appears in a token read by `Reader`.
+       */
+      void WriteString(const StringView& value) {
+        Prepare(Slot::kString);
+        PutStringView(value);
+      }
+
+      void WriteReference(uint32_t id) {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kObjectReference);
+        PutVarint(id);
+      }
+
+      /**
+       * Write a missing element of a dense array.
+       */
+      void WriteHole() {
+        if (_stack.empty() || _stack.back().kind != Kind::kDenseArray) {
+          Fail("Holes are only allowed in dense arrays");
+          return;
+        }
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kTheHole);
+      }
+
+      uint32_t BeginObject() {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kBeginJSObject);
+        return Push(Kind::kObject);
+      }
+
+      bool EndObject() {
+        if (!Pop(Kind::kObject) || _popped.count % 2) {
+          return Fail("Object has a key without a value");
+        }
+        PutTag(wire::Tag::kEndJSObject);
+        PutVarint(_popped.count / 2);
+        return true;
+      }
+
+      /**
+       * Begin an array. Dense arrays are followed by exactly `length`
+       * elements (or holes), sparse arrays by index and value pairs. Both may
+       * then have additional key and value pairs.
+       */
+      uint32_t BeginArray(uint32_t length, bool sparse = false) {
+        Prepare(Slot::kOther);
+        PutTag(
+          sparse ? wire::Tag::kBeginSparseJSArray
+                 : wire::Tag::kBeginDenseJSArray);
+        PutVarint(length);
+        return Push(sparse ? Kind::kSparseArray : Kind::kDenseArray, length);
+      }
+
+      bool EndArray() {
+        if (_stack.empty()) {
+          return Fail("No array to end");
+        }
+        bool sparse = _stack.back().kind == Kind::kSparseArray;
+        if (!Pop(sparse ? Kind::kSparseArray : Kind::kDenseArray)) {
+          return false;
+        }
+        uint32_t properties = _popped.count;
+        if (!sparse) {
+          if (properties < _popped.length) {
+            return Fail("Dense array is missing elements");
+          }
+          properties -= _popped.length;
+        }
+        if (properties % 2) {
+          return Fail("Array has a key without a value");
+        }
+        PutTag(
+          sparse ? wire::Tag::kEndSparseJSArray : wire::Tag::kEndDenseJSArray);
+        PutVarint(properties / 2);
+        PutVarint(_popped.length);
+        return true;
+      }
+
+      uint32_t BeginMap() {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kBeginJSMap);
+        return Push(Kind::kMap);
+      }
+
+      bool EndMap() {
+        if (!Pop(Kind::kMap) || _popped.count % 2) {
+          return Fail("Map has a key without a value");
+        }
+        PutTag(wire::Tag::kEndJSMap);
+        PutVarint(_popped.count);
+        return true;
+      }
+
+      uint32_t BeginSet() {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kBeginJSSet);
+        return Push(Kind::kSet);
+      }
+
+      bool EndSet() {
+        if (!Pop(Kind::kSet)) {
+          return false;
+        }
+        PutTag(wire::Tag::kEndJSSet);
+        PutVarint(_popped.count);
+        return true;
+      }
+
+      uint32_t WriteDate(double time) {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kDate);
+        _sink.Write(&time, sizeof(time));
+        return _nextId++;
+      }
+
+      uint32_t WriteRegExp(std::string_view pattern, uint32_t flags) {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kRegExp);
+        PutString(pattern);
+        PutVarint(flags);
+        return _nextId++;
+      }
+
+      uint32_t WriteRegExp(const StringView& pattern, uint32_t flags) {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kRegExp);
+        PutStringView(pattern);
+        PutVarint(flags);
+        return _nextId++;
+      }
+
+      uint32_t WriteBooleanObject(bool value) {
+        Prepare(Slot::kOther);
+        PutTag(value ? wire::Tag::kTrueObject : wire::Tag::kFalseObject);
+        return _nextId++;
+      }
+
+      uint32_t WriteNumberObject(double value) {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kNumberObject);
+        _sink.Write(&value, sizeof(value));
+        return _nextId++;
+      }
+
+      uint32_t WriteBigIntObject(
+        bool negative, const uint8_t* digits, size_t size) {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kBigIntObject);
+        PutBigIntContents(negative, digits, size);
+        return _nextId++;
+      }
+
+      uint32_t WriteStringObject(std::string_view value) {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kStringObject);
+        PutString(value);
+        return _nextId++;
+      }
+
+      uint32_t WriteStringObject(const StringView& value) {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kStringObject);
+        PutStringView(value);
+        return _nextId++;
+      }
+
+      uint32_t WriteArrayBuffer(const void* data, size_t size) {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kArrayBuffer);
+        PutVarint(static_cast<uint32_t>(size));
+        _sink.Write(data, size);
+        return _nextId++;
+      }
+
+      /**
+       * Write an ArrayBuffer that can grow up to `maxSize` bytes.
+       */
+      uint32_t WriteResizableArrayBuffer(
+        const void* data, size_t size, size_t maxSize) {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kResizableArrayBuffer);
+        PutVarint(static_cast<uint32_t>(size));
+        PutVarint(static_cast<uint32_t>(maxSize));
+        _sink.Write(data, size);
+        return _nextId++;
+      }
+
+      /**
+       * Write a view over the array buffer written (or referenced) just
+       * before. Together they form a single value.
+       */
+      uint32_t WriteArrayBufferView(
+        wire::ArrayBufferViewTag type,
+        uint32_t byteOffset,
+        uint32_t byteLength,
+        uint32_t flags = 0) {
+        PutTag(wire::Tag::kArrayBufferView);
+        _sink.Put(static_cast<uint8_t>(type));
+        PutVarint(byteOffset);
+        PutVarint(byteLength);
+        PutVarint(flags);
+        return _nextId++;
+      }
+
+      /**
+       * Begin an error. A single value written before `EndError` becomes its
+       * cause. Pass `wire::ErrorTag::kEnd` as the prototype for `Error`.
+       */
+      uint32_t BeginError(
+        wire::ErrorTag prototype,
+        const std::string_view* message,
+        const std::string_view* stack) {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kError);
+        if (prototype != wire::ErrorTag::kEnd) {
+          _sink.Put(static_cast<uint8_t>(prototype));
+        }
+        if (message) {
+          _sink.Put(static_cast<uint8_t>(wire::ErrorTag::kMessage));
+          PutString(*message);
+        }
+        if (stack) {
+          _sink.Put(static_cast<uint8_t>(wire::ErrorTag::kStack));
+          PutString(*stack);
+        }
+        return Push(Kind::kError);
+      }
+
+      bool EndError() {
+        if (!Pop(Kind::kError)) {
+          return false;
+        }
+        _sink.Put(static_cast<uint8_t>(wire::ErrorTag::kEnd));
+        return true;
+      }
+
+      /**
+       * Begin a host object with exactly `properties` key and value pairs.
+       * `className` is only used for `HostClass::kNamed`.
+       */
+      uint32_t BeginHostObject(
+        HostClass hostClass, std::string_view className, uint32_t properties) {
+        Prepare(Slot::kOther);
+        PutTag(wire::Tag::kHostObject);
+        switch (hostClass) {
+          case HostClass::kPlain: PutTag(wire::Tag::kUndefined); break;
+          case HostClass::kNullPrototype: PutTag(wire::Tag::kNull); break;
+          case HostClass::kNamed: PutString(className); break;
+          case HostClass::kEntry:
+            Fail("Dictionary entries are written by index");
+            break;
+        }
+        PutVarint(properties);
+        return Push(Kind::kHost, properties);
+      }
+
+      /**
+       * Begin an instance of the class named by shared dictionary entry
+       * `entry`, with exactly `properties` key and value pairs.
+       */
+      uint32_t BeginHostObject(uint32_t entry, uint32_t properties) {
+        Prepare(Slot::kOther);
+        if (!_dictionary) {
+          Fail("Dictionary entries require a dictionary header");
+        } else if (entry > INT32_MAX) {
+          Fail("Dictionary entry is out of range");
+        }
+        PutTag(wire::Tag::kHostObject);
+        PutTag(wire::Tag::kInt32);
+        PutVarint(entry << 1);
+        PutVarint(properties);
+        return Push(Kind::kHost, properties);
+      }
+
+      bool EndHostObject() {
+        if (!Pop(Kind::kHost)) {
+          return false;
+        }
+        if (_popped.count != _popped.length * 2) {
+          return Fail("Host object property count mismatch");
+        }
+        return true;
+      }
+
+      /**
+       * Write a global symbol, by description, as a host object key or value.
+       */
+      void WriteSymbol(std::string_view description) {
+        Prepare(Slot::kSymbol);
+        PutString(description);
+      }
+
+      void WriteSymbol(const StringView& description) {
+        Prepare(Slot::kSymbol);
+        PutStringView(description);
+      }
+
+      /**
+       * Write shared dictionary entry `index` as a host object key.
+       */
+      void WriteEntry(uint32_t index) {
+        Prepare(Slot::kEntry);
+        if (!_dictionary) {
+          Fail("Dictionary entries require a dictionary header");
+        }
+        PutVarint(index);
+      }
+
+      /**
+       * Write a reference to the enclosing host object as a property value.
+       */
+      void WriteSelf() {
+        Prepare(Slot::kSelf);
+      }
+
+        protected:
+      enum class Kind : uint8_t {
+        kObject,
+        kDenseArray,
+        kSparseArray,
+        kMap,
+        kSet,
+        kError,
+        kHost,
+      };
+
+      enum class Slot : uint8_t {
+        kString,
+        kNumber,
+        kSymbol,
+        kSelf,
+        kEntry,
+        kOther,
+      };
+
+      struct Frame {
+        Kind kind;
+        uint32_t count;  // Keys and values written so far
+        uint32_t length; // Array length or host property count
+      };
+
+      bool Fail(const char* message) {
+        if (!_error) {
+          _error = message;
+        }
+        return false;
+      }
+
+      // Account for a value about to be written into the current container.
+      void Prepare(Slot slot) {
+        if (_stack.empty()) {
+          if (_rootWritten) {
+            Fail("Only one root value can be written");
+          }
+          _rootWritten = true;
+          if (slot == Slot::kSymbol || slot == Slot::kSelf) {
+            Fail("Symbols can only be written inside host objects");
+          } else if (slot == Slot::kEntry) {
+            Fail("Dictionary entries can only be host object keys");
+          }
+          return;
+        }
+        Frame& frame = _stack.back();
+        bool key = frame.count % 2 == 0;
+        ++frame.count;
+        if (frame.kind == Kind::kHost) {
+          if (frame.count > frame.length * 2) {
+            Fail("Too many host object properties");
+          }
+          if (key) {
+            switch (slot) {
+              case Slot::kString: PutVarint(wire::kString); break;
+              case Slot::kNumber: PutVarint(wire::kNumber); break;
+              case Slot::kSymbol: PutVarint(wire::kSymbol); break;
+              case Slot::kEntry: PutVarint(wire::kEntry); break;
+              default: Fail("Invalid host object key");
+            }
+          } else if (slot == Slot::kEntry) {
+            Fail("Dictionary entries can only be host object keys");
+          } else {
+            PutVarint(
+              slot == Slot::kSelf       ? wire::vSelf
+                : slot == Slot::kSymbol ? wire::vSymbol
+                                        : wire::vValue);
+          }
+          return;
+        }
+        if (slot == Slot::kSymbol || slot == Slot::kSelf) {
+          Fail("Symbols can only be written inside host objects");
+        } else if (slot == Slot::kEntry) {
+          Fail("Dictionary entries can only be host object keys");
+        } else if (frame.kind == Kind::kError) {
+          if (frame.count > 1) {
+            Fail("An error can only have one cause");
+          }
+          _sink.Put(static_cast<uint8_t>(wire::ErrorTag::kCause));
+        }
+      }
+
+      uint32_t Push(Kind kind, uint32_t length = 0) {
+        _stack.push_back(Frame {kind, 0, length});
+        return _nextId++;
+      }
+
+      bool Pop(Kind kind) {
+        if (_stack.empty() || _stack.back().kind != kind) {
+          return Fail("Mismatched container end");
+        }
+        _popped = _stack.back();
+        _stack.pop_back();
+        return true;
+      }
+
+      void PutTag(wire::Tag tag) {
+        _sink.Put(static_cast<uint8_t>(tag));
+      }
+
+      void PutVarint(uint32_t value) {
+        while (value >= 0x80) {
+          _sink.Put(static_cast<uint8_t>(value | 0x80));
+          value >>= 7;
+        }
+        _sink.Put(static_cast<uint8_t>(value));
+      }
+
+      static size_t VarintSize(uint32_t value) {
+        size_t size = 1;
+        while (value >= 0x80) {
+          value >>= 7;
+          ++size;
+        }
+        return size;
+      }
+
+      void PutBigIntContents(
+        bool negative, const uint8_t* digits, size_t size) {
+        PutVarint(static_cast<uint32_t>((size << 1) | (negative ? 1 : 0)));
+        _sink.Write(digits, size);
+      }
+
+      void PutOneByteString(const uint8_t* chars, size_t length) {
+        PutTag(wire::Tag::kOneByteString);
+        PutVarint(static_cast<uint32_t>(length));
+        _sink.Write(chars, length);
+      }
+
+      void PutTwoByteHeader(uint32_t size) {
+        // Two-byte data is kept aligned, as V8 does.
+        if ((_sink.size() + 1 + VarintSize(size)) & 1) {
+          PutTag(wire::Tag::kPadding);
+        }
+        PutTag(wire::Tag::kTwoByteString);
+        PutVarint(size);
+      }
+
+      void PutTwoByteString(const uint16_t* chars, size_t length) {
+        uint32_t size = static_cast<uint32_t>(length * 2);
+        PutTwoByteHeader(size);
+        _sink.Write(chars, size);
+      }
+
+      void PutString(std::string_view value) {
+        bool ascii = true;
+        for (unsigned char c : value) {
+          if (c >= 0x80) {
+            ascii = false;
+            break;
+          }
+        }
+        PutTag(ascii ? wire::Tag::kOneByteString : wire::Tag::kUtf8String);
+        PutVarint(static_cast<uint32_t>(value.size()));
+        _sink.Write(value.data(), value.size());
+      }
+
+      void PutStringView(const StringView& value) {
+        switch (value.encoding) {
+          case StringEncoding::kLatin1:
+            PutOneByteString(value.data, value.size);
+            break;
+          case StringEncoding::kUtf8:
+            PutTag(wire::Tag::kUtf8String);
+            PutVarint(static_cast<uint32_t>(value.size));
+            _sink.Write(value.data, value.size);
+            break;
+          case StringEncoding::kUtf16:
+            PutTwoByteHeader(static_cast<uint32_t>(value.size));
+            _sink.Write(value.data, value.size);
+            break;
+        }
+      }
+
+      Sink _sink;
+      const char* _error = nullptr;
+      uint32_t _nextId = 0;
+      bool _rootWritten = false;
+      bool _dictionary = false; // A dictionary header was written
+      std::vector<Frame> _stack;
+      Frame _popped {};
+    };
+
+    using Writer = BasicWriter<BufferSink>;
+  } // namespace format
+} // namespace serialism
+
+#endif // SERIALISM_WRITER_H
@@ -11,7 +11,7 @@ const createConfig = (output) => {
       preserveModules: true,
       sourcemap: true,
     },
-    external: ['bindings', 'nan'],
+    external: ['bindings', 'nan', /^node:/],
     plugins: [
       nodeResolve(),
       typescript({
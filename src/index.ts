@@ -1,6 +1,124 @@
 /* eslint-disable @typescript-eslint/no-unused-vars */
 import bindings from 'bindings';
-import type { Buffer } from 'node:buffer';
+import { Buffer } from 'node:buffer';
+import { Worker, workerData, type WorkerOptions } from 'node:worker_threads';
+
+/**
+ * Options accepted by the {@link Serialism} constructor.
+ */
+interface SerialismOptions {
+  /**
+   * Append a CRC32C checksum trailer to serialized buffers and verify it
+   * before deserializing. Both ends must enable this option.
+   * @default false
+   */
+  checksum?: boolean;
+
+  /**
+   * How object graphs are walked. `'recursive'` uses V8's serializer, which
+   * recurses on the native stack. `'iterative'` keeps pending values on an
+   * explicit stack, so graphs of any depth can be processed. Both produce the
+   * same wire format and can read each other's output.
+   * @default 'recursive'
+   */
+  traversal?: 'recursive' | 'iterative';
+
+  /**
+   * Produce the same bytes for logically equal values: object keys, map
+   * entries and set values are written in sorted order, and strings in
+   * their most compact encoding. Implies iterative traversal when
+   * serializing.
+   * @default false
+   */
+  canonical?: boolean;
+
+  /**
+   * Share a dictionary of strings with the other end, so that class names
+   * and the string keys of registered class instances are written as small
+   * entry indexes instead of in full. Both ends must use the same dictionary.
+   */
+  dictionary?: DictionaryOptions;
+}
+
+/**
+ * A dictionary shared by the instances that write and read payloads. Its
+ * entries are the given `strings`, the names of registered classes and the
+ * fields in their `include` lists, in sorted order.
+ */
+interface DictionaryOptions {
+  /**
+   * Identifies the dictionary. It is written at the start of every payload
+   * and checked when reading, so change it whenever the strings or the
+   * registered classes change.
+   */
+  id: number;
+  /** Additional strings, such as common property names. */
+  strings?: string[];
+}
+
+/**
+ * Options accepted by {@link Serialism.serialize}.
+ */
+interface SerializeOptions {
+  /**
+   * Also compute the XXH64 digest of the payload while it is written.
+   * @default false
+   */
+  fingerprint?: boolean;
+}
+
+/**
+ * The result of {@link Serialism.serialize} with `fingerprint` set.
+ */
+interface Fingerprinted {
+  /** The serialized data. */
+  buffer: Buffer;
+  /**
+   * The XXH64 digest (seed 0) of the payload, excluding any checksum
+   * trailer.
+   */
+  fingerprint: bigint;
+}
+
+/**
+ * Options accepted by {@link Serialism.estimateSize}.
+ */
+interface EstimateSizeOptions {
+  /**
+   * Also report the bytes taken by instances of each registered class.
+   * @default false
+   */
+  byClass?: boolean;
+}
+
+/**
+ * The result of {@link Serialism.estimateSize} with `byClass` set.
+ */
+interface SizeEstimate {
+  /**
+   * The size of the buffer `serialize()` would return, in bytes. Arrays
+   * whose storage V8 picked differently than the estimate guesses make it
+   * too high or too low, see the README.
+   */
+  total: number;
+  /**
+   * Bytes written for instances of each registered class, by class name.
+   * Bytes are counted toward the innermost instance being written, so the
+   * size of a nested instance is not included in its parent's.
+   */
+  classes: Record<string, number>;
+}
+
+/**
+ * Options that may follow a class passed to {@link Serialism.register}.
+ * Properties not written are absent from deserialized instances.
+ */
+interface ClassOptions {
+  /** Write only these own properties, in this order. */
+  include?: (string | symbol)[];
+  /** Write all own properties except these. */
+  exclude?: (string | symbol)[];
+}
 
 /**
  * Serialism is a library for serializing and deserializing JavaScript values.
@@ -16,14 +134,32 @@ import type { Buffer } from 'node:buffer';
  * ```
  */
 declare class Serialism {
+  /**
+   * Create a new Serialism instance.
+   * @param options Options for this instance.
+   * @throws Throws an error if `options` is not an object.
+   * @throws Throws an error if the `dictionary` option is malformed.
+   */
+  public constructor(options?: SerialismOptions);
+
   /**
    * Serialize a JavaScript value.
    * @param value The value to serialize.
-   * @returns A `Buffer` instance containing the serialized data.
+   * @param options Options for this call.
+   * @returns A `Buffer` instance containing the serialized data, or a
+   *   {@link Fingerprinted} result if `fingerprint` is set.
    * @throws Throws an error if a non-serializable is encountered.
    *   This includes non-global symbol, native object, unregistered class, etc)
    */
   public serialize(value: unknown): Buffer;
+  public serialize(
+    value: unknown,
+    options: SerializeOptions & { fingerprint: true },
+  ): Fingerprinted;
+  public serialize(
+    value: unknown,
+    options?: SerializeOptions,
+  ): Buffer | Fingerprinted;
 
   /**
    * Deserialize a NodeJS.Buffer to a JavaScript value.
@@ -31,14 +167,99 @@ declare class Serialism {
    * @returns The deserialized object.
    * @throws Throws an error if the buffer is incompatible or malformed.
    * @throws Throws an error if a non-registered class is encountered.
+   * @throws Throws an error if checksums are enabled and the buffer is corrupt.
+   * @throws Throws an error if the buffer was written with a different
+   *   shared dictionary.
    */
   public deserialize<T>(buffer: Buffer): T;
 
+  /**
+   * Deserialize a buffer into an existing object graph, updating its objects
+   * in place instead of allocating new ones. An object in `target` is reused
+   * if the payload has a plain object, array, map, set or instance of the
+   * same registered class at the same position, and loses the properties
+   * and entries the payload does not have. Other values are allocated.
+   * @param buffer The buffer to deserialize.
+   * @param target The graph to update.
+   * @returns `target` if it was reused, or the newly allocated root value.
+   * @throws Throws an error if the buffer is incompatible or malformed, in
+   *   which case `target` may have been partially updated.
+   * @throws Throws a TypeError if a property of `target` cannot be changed,
+   *   such as one of a frozen object. `target` may have been partially
+   *   updated.
+   * @throws Throws an error if a non-registered class is encountered.
+   */
+  public deserializeInto<T>(buffer: Buffer, target: T): T;
+
+  /**
+   * Split an array, map or set into `shards` payloads that can each be
+   * deserialized on their own, for example by different worker threads.
+   * Items are divided into contiguous runs of nearly equal length. Each
+   * shard is self-contained: objects reachable from several shards are
+   * written into each of them and are no longer shared after decoding.
+   * @param value The array, map or set to split.
+   * @param shards The number of shards to produce. No more shards than
+   *   items are produced, and a single empty one for an empty container.
+   * @returns One `Buffer` per shard.
+   * @throws Throws an error if `value` is not an array, map or set.
+   * @throws Throws an error if `shards` is not a positive integer.
+   */
+  public serializeSharded(
+    value: unknown[] | Map<unknown, unknown> | Set<unknown>,
+    shards: number,
+  ): Buffer[];
+
+  /**
+   * Deserialize shards produced by {@link Serialism.serializeSharded} and
+   * merge them, in order, into a single array, map or set. This runs on the
+   * calling thread; see {@link processShards} to decode shards in parallel.
+   * @param shards The shards, in the order they were produced.
+   * @returns The merged container.
+   * @throws Throws an error if a shard is malformed or the shards hold
+   *   different kinds of containers.
+   */
+  public deserializeShards<T>(shards: Buffer[]): T;
+
+  /**
+   * Deep-copy a JavaScript value without going through a buffer.
+   * The copy is identical to `deserialize(serialize(value))`: shared and
+   * circular references are preserved and registered classes keep their
+   * prototypes, but strings and other primitives are shared with the source.
+   * @param value The value to clone.
+   * @returns A structurally identical copy of `value`.
+   * @throws Throws an error if a non-serializable value is encountered.
+   * @throws Throws an error if a non-registered class is encountered.
+   */
+  public clone<T>(value: T): T;
+
+  /**
+   * Compute the size of the buffer `serialize(value)` would return, without
+   * producing it. Nothing is copied or allocated for the output. The size of
+   * arrays can differ from V8's encoding of them, see {@link SizeEstimate}.
+   * @param value The value to measure.
+   * @param options Options for the estimate.
+   * @returns The size in bytes, or a {@link SizeEstimate} if `byClass` is set.
+   * @throws Throws an error if a non-serializable value is encountered.
+   * @throws Throws an error if a non-registered class is encountered.
+   */
+  public estimateSize(value: unknown): number;
+  public estimateSize(
+    value: unknown,
+    options: EstimateSizeOptions & { byClass: true },
+  ): SizeEstimate;
+  public estimateSize(
+    value: unknown,
+    options?: EstimateSizeOptions,
+  ): number | SizeEstimate;
+
   /**
    * Register class constructors for serialization/deserialization.
-   * @param classes Class constructors
+   * A class may be followed by {@link ClassOptions} for its instances.
+   * Registering a class again with options replaces its previous options.
+   * @param classes Class constructors, each optionally followed by options.
    * @returns The Serialism instance for chaining.
    * @throws Throws an error if a class is already registered.
+   * @throws Throws an error if options list both `include` and `exclude`.
    * @example
    * ```typescript
    * import {Serialism} from 'serialism';
@@ -50,14 +271,92 @@ declare class Serialism {
    * const buffer = serialism.serialize(new MyClass('example'));
    * const obj = serialism.deserialize(buffer);
    * console.log(obj); // MyClass { name: 'example' }
+   * serialism.register(MyClass, { exclude: ['cache'] });
    * ```
    */
-  public register(...classes: (new (...args: never[]) => unknown)[]): this;
+  public register(
+    ...classes: ((new (...args: never[]) => unknown) | ClassOptions)[]
+  ): this;
 }
 
 /** @ignore */
 const SerialismInstance = bindings('serialism').Serialism as typeof Serialism;
 
-export { SerialismInstance as Serialism };
+/**
+ * Run the script `filename` in one worker thread per shard produced by
+ * {@link Serialism.serializeSharded}. Each worker is given a copy of its
+ * shard, which it reads with {@link readShard}, and posts its result back
+ * with `parentPort.postMessage()`.
+ * @param shards The shards to process.
+ * @param filename The worker script, as for `new Worker()`.
+ * @param options Other options for the workers.
+ * @returns The first message posted by each worker, in shard order.
+ * @throws Rejects if a worker throws or exits without posting a message.
+ * @example
+ * ```typescript
+ * const counts = await processShards<number>(
+ *   serialism.serializeSharded(records, os.availableParallelism()),
+ *   './count-records.js',
+ * );
+ *
+ * // count-records.js
+ * const records = readShard(new Serialism().register(Record));
+ * parentPort.postMessage(records.length);
+ * ```
+ */
+function processShards<R>(
+  shards: Buffer[],
+  filename: string | URL,
+  options?: Omit<WorkerOptions, 'workerData'>,
+): Promise<R[]> {
+  return Promise.all(
+    shards.map(
+      (shard) =>
+        new Promise<R>((resolve, reject) => {
+          const worker = new Worker(filename, {
+            ...options,
+            workerData: shard,
+          });
+          worker.once('message', resolve);
+          worker.once('error', reject);
+          worker.once('exit', (code) =>
+            reject(
+              new Error(`Worker exited with code ${code} without a result`),
+            ),
+          );
+        }),
+    ),
+  );
+}
+
+/**
+ * Deserialize the shard of a worker started by {@link processShards}.
+ * @param serialism An instance with the options and classes of the one that
+ *   produced the shards.
+ * @returns The container holding the items of the shard.
+ * @throws Throws an error if not called in such a worker.
+ */
+function readShard<T>(serialism: Serialism): T {
+  if (!(workerData instanceof Uint8Array)) {
+    throw new Error(
+      'readShard() must be called in a worker started by processShards()',
+    );
+  }
+  return serialism.deserialize<T>(
+    Buffer.from(workerData.buffer, workerData.byteOffset, workerData.length),
+  );
+}
+
+export { SerialismInstance as Serialism, processShards, readShard };
+
+export type {
+  ClassOptions,
+  DictionaryOptions,
+  EstimateSizeOptions,
+  Fingerprinted,
+  SerialismOptions,
+  SerializeOptions,
+  SizeEstimate,
+};
 
 export default SerialismInstance;
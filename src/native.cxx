@@ -1,4 +1,18 @@
 #include <nan.h>
+#include <serialism/checksum.h>
+#include <serialism/reader.h>
+#include <serialism/wire.h>
+#include <serialism/writer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #ifdef SERIALISM_DEBUG
 #  include <cstdint>
@@ -15,31 +29,92 @@ using namespace node;
 enum InternalFields : uint32_t {
   kSerialismInstance = 0, // Instance of Serialism
   kKnownClasses,          // Map for storing registered classes
+  kClassFields,           // Map of field lists by registered class name
+  kOptionFlags,           // Options passed to the constructor
+  kDictionaryId,          // Id of the shared dictionary, or undefined
+  kDictionaryStrings,     // Strings given for the shared dictionary
+  kDictionaryEntries,     // Array of dictionary entries, built on demand
+  kDictionaryIndexes,     // Map of dictionary entry indexes by string
   kInternalFieldCount     // Count of internal fields
 };
 
+/**
+ * Option flags parsed from the constructor's options object.
+ */
+enum OptionFlags : uint32_t {
+  fNone = 0,
+  fChecksum = 1 << 0,  // Append and verify a CRC32C trailer
+  fIterative = 1 << 1, // Traverse values with an explicit stack
+  fCanonical = 1 << 2, // Sort keys and entries for deterministic output
+};
+
 namespace delegate {
-  enum CustomHostKeyKind : uint32_t {
-    kString = 0, // String key
-    kSymbol,     // Symbol key
-    kNumber,     // Number key
-  };
-  enum CustomHostValueKind : uint32_t {
-    vValue = 0, // Regular value
-    vSymbol,    // Symbol value
-    vSelf,      // Self-reference
+  // Host object key and value kinds are shared with the standalone format
+  // library in include/serialism.
+  using namespace serialism::wire;
+
+  /**
+   * Look up the index of `value` in the shared dictionary `indexes`, which
+   * is empty if none is used.
+   */
+  inline bool FindEntry(
+    Local<Context> context,
+    Local<Map> indexes,
+    Local<Value> value,
+    uint32_t* index) {
+    Local<Value> found;
+    if (
+      indexes.IsEmpty() || !indexes->Get(context, value).ToLocal(&found) ||
+      !found->IsUint32()) {
+      return false;
+    }
+    *index = found.As<Uint32>()->Value();
+    return true;
+  }
+
+  // How objects are written, by prototype.
+  enum class ClassKind : uint8_t {
+    kPlain,        // Plain object, a host object only if it has symbols
+    kRegistered,   // Instance of a registered class
+    kUnregistered, // Instance of a class that is not registered
   };
 
   class SerializeDelegate: public ValueSerializer::Delegate {
       private:
+    struct ClassDecision {
+      Global<Value> prototype;
+      Global<Function> constructor; // The registered class, if any
+      ClassKind kind;
+    };
+
     // A set to keep track of registered classes for serialization
     Local<Map> _registeredClasses;
+    // Fields to include (an array) or exclude (a set) by class name
+    Local<Map> _classFields;
+    // Shared dictionary entry indexes by string, if one is used
+    Local<Map> _dictionary;
     ValueSerializer* _serializer = nullptr;
+    Local<Value> _objectPrototype;
+    Local<Value> _objectConstructor;
+    // Prototypes seen so far, other than `Object.prototype`. These are held
+    // across the handle scopes of the encoder.
+    std::vector<ClassDecision> _decisions;
+    bool _optimistic = false;
+    bool _symbolError = false;
 
     // Custom delegate implementation
       public:
-    SerializeDelegate(Isolate* isolate, Local<Map> classes):
-      _registeredClasses(classes) {}
+    SerializeDelegate(
+      Isolate* isolate, Local<Map> classes, Local<Map> fields):
+      _registeredClasses(classes),
+      _classFields(fields) {
+      auto context = isolate->GetCurrentContext();
+      _objectPrototype = Object::New(isolate)->GetPrototype();
+      _objectConstructor =
+        context->Global()
+          ->Get(context, Nan::New("Object").ToLocalChecked())
+          .ToLocalChecked();
+    }
 
     virtual ~SerializeDelegate() = default;
 
@@ -47,11 +122,55 @@ namespace delegate {
       this->_serializer = serializer;
     }
 
+    /**
+     * Write the class names and string keys of host objects that are in the
+     * shared dictionary `indexes` as entry indexes.
+     */
+    void UseDictionary(Local<Map> indexes) {
+      _dictionary = indexes;
+    }
+
+    /**
+     * Skip the scan for symbol values of plain objects whose properties are
+     * all enumerable, as V8 and the encoder report those as clone errors. A
+     * call that fails with one has to be retried after `Precise()`.
+     */
+    void Optimistic() {
+      _optimistic = true;
+    }
+
+    void Precise() {
+      _optimistic = false;
+      _symbolError = false;
+    }
+
+    // Whether a symbol could not be cloned since the last `Precise()`.
+    bool symbolError() const {
+      return _symbolError;
+    }
+
     virtual void ThrowDataCloneError(Local<String> message) override {
-      Isolate* isolate = Isolate::GetCurrent();
+      bool symbol = false;
+      if (_optimistic) {
+        // V8 only passes the message, which describes symbols as
+        // `Symbol(...)`, or `[object Symbol]` when wrapped. Anything else
+        // that matches only costs a retry.
+        Nan::Utf8String text(message);
+        std::string_view view(*text, text.length());
+        symbol = view.rfind("Symbol(", 0) == 0 ||
+          view.rfind("[object Symbol]", 0) == 0;
+      }
+      ThrowCloneError(message, symbol);
+    }
+
+    // Throw a clone error, noting whether the value was a symbol.
+    void ThrowCloneError(Local<String> message, bool symbol) {
+      _symbolError |= _optimistic && symbol;
       Nan::ThrowError(
         String::Concat(
-          isolate, Nan::New("Data clone error: ").ToLocalChecked(), message));
+          Isolate::GetCurrent(),
+          Nan::New("Data clone error: ").ToLocalChecked(),
+          message));
     }
 
     virtual bool HasCustomHostObject(Isolate* isolate) override {
@@ -69,48 +188,184 @@ namespace delegate {
         .ToLocalChecked();
     }
 
-    MaybeLocal<Function> MatchHostObjectConstructor(
-      Isolate* isolate, Local<Object> value) {
-#ifdef SERIALISM_DEBUG
-      std::cout << "[Serializer] Getting host object constructor for class: "
-                << *Nan::Utf8String(value->GetConstructorName()) << std::endl;
-#endif
-      auto context = isolate->GetCurrentContext();
-      auto maybeProto = value->GetPrototype();
-      if (maybeProto.IsEmpty() || !maybeProto->IsObject()) {
-        return MaybeLocal<Function>();
+    /**
+     * Look up the fields registered for the class named `className`. Returns
+     * an empty handle if all of its properties are written.
+     */
+    Local<Value> GetClassFields(
+      Local<Context> context, Local<Value> className) {
+      Local<Value> fields;
+      if (
+        _classFields->Size() == 0 || !className->IsString() ||
+        !_classFields->Get(context, className).ToLocal(&fields) ||
+        fields->IsUndefined()) {
+        return Local<Value>();
       }
-      auto maybeValueCtor = maybeProto.As<Object>()->Get(
-        context, Nan::New("constructor").ToLocalChecked());
-      if (maybeValueCtor.IsEmpty()) {
-#ifdef SERIALISM_DEBUG
-        std::cout << "[Serializer] No constructor found for object."
-                  << std::endl;
-#endif
-        return MaybeLocal<Function>(); // No constructor found
+      return fields;
+    }
+
+    /**
+     * List the properties written for a host object: the own properties in
+     * an include list, or all own properties but those in an exclude set.
+     */
+    MaybeLocal<Array> GetHostPropertyNames(
+      Local<Context> context, Local<Object> object, Local<Value> fields) {
+      Isolate* isolate = context->GetIsolate();
+      std::vector<Local<Value>> names;
+      if (!fields.IsEmpty() && fields->IsArray()) {
+        auto included = fields.As<Array>();
+        for (uint32_t i = 0; i < included->Length(); ++i) {
+          Local<Value> key;
+          bool own;
+          if (
+            !included->Get(context, i).ToLocal(&key) ||
+            !object->HasOwnProperty(context, key.As<Name>()).To(&own)) {
+            return MaybeLocal<Array>();
+          }
+          if (own) {
+            names.push_back(key);
+          }
+        }
+        return Array::New(isolate, names.data(), names.size());
+      }
+      auto keys = GetAllPropertyNames(context, object);
+      if (fields.IsEmpty()) {
+        return keys;
+      }
+      auto excluded = fields.As<Set>();
+      for (uint32_t i = 0; i < keys->Length(); ++i) {
+        Local<Value> key;
+        if (!keys->Get(context, i).ToLocal(&key)) {
+          return MaybeLocal<Array>();
+        }
+        // Index keys are listed as numbers.
+        Local<Value> name = key;
+        bool skip;
+        if (
+          (key->IsNumber() && !key->ToString(context).ToLocal(&name)) ||
+          !excluded->Has(context, name).To(&skip)) {
+          return MaybeLocal<Array>();
+        }
+        if (!skip) {
+          names.push_back(key);
+        }
+      }
+      if (names.size() == keys->Length()) {
+        return keys;
+      }
+      return Array::New(isolate, names.data(), names.size());
+    }
+
+    /**
+     * Find how objects with the prototype of `object` are written, and the
+     * registered class of its instances. Plain objects have `Object` as the
+     * constructor of their prototype. Decisions are kept for the lifetime
+     * of the delegate, which is one call.
+     */
+    ClassKind Classify(
+      Isolate* isolate,
+      Local<Object> object,
+      Local<Function>* registered = nullptr) {
+      Local<Value> prototype = object->GetPrototype();
+      if (prototype == _objectPrototype) {
+        return ClassKind::kPlain;
+      }
+      for (auto& decision : _decisions) {
+        if (decision.prototype == prototype) {
+          if (registered && decision.kind == ClassKind::kRegistered) {
+            *registered = decision.constructor.Get(isolate);
+          }
+          return decision.kind;
+        }
       }
-      auto valueCtor = maybeValueCtor.ToLocalChecked().As<Function>();
-      const Local<Array> array = _registeredClasses->AsArray();
-      for (unsigned int i = 0; i < _registeredClasses->Size(); ++i) {
-        // auto name = array->Get(isolate->GetCurrentContext(), i * 2)
-        //                 .ToLocalChecked()
-        //                 .As<Function>();
-        auto classCtor = array->Get(isolate->GetCurrentContext(), i * 2 + 1)
-                           .ToLocalChecked()
-                           .As<Function>();
-        if (valueCtor->StrictEquals(classCtor)) {
 #ifdef SERIALISM_DEBUG
-          std::cout << "[Serializer] Found matching constructor: "
-                    << *Nan::Utf8String(classCtor->GetName()) << std::endl;
+      std::cout << "[Serializer] Classifying prototype of `"
+                << *Nan::Utf8String(object->GetConstructorName()) << "`, "
+                << "registery has " << _registeredClasses->Size()
+                << " classes" << std::endl;
 #endif
-          return classCtor;
+      auto context = isolate->GetCurrentContext();
+      ClassKind kind = ClassKind::kUnregistered;
+      Local<Value> constructor;
+      if (
+        prototype->IsObject() &&
+        prototype.As<Object>()
+          ->Get(context, Nan::New("constructor").ToLocalChecked())
+          .ToLocal(&constructor)) {
+        if (constructor->StrictEquals(_objectConstructor)) {
+          kind = ClassKind::kPlain;
+        } else if (constructor->IsFunction()) {
+          const Local<Array> array = _registeredClasses->AsArray();
+          for (uint32_t i = 1; i < array->Length(); i += 2) {
+            Local<Value> classCtor;
+            if (
+              array->Get(context, i).ToLocal(&classCtor) &&
+              constructor->StrictEquals(classCtor)) {
+              kind = ClassKind::kRegistered;
+              break;
+            }
+          }
         }
       }
-      return MaybeLocal<Function>();
+      _decisions.push_back(
+        {Global<Value>(isolate, prototype),
+         Global<Function>(
+           isolate,
+           kind == ClassKind::kRegistered ? constructor.As<Function>()
+                                          : Local<Function>()),
+         kind});
+      if (registered && kind == ClassKind::kRegistered) {
+        *registered = constructor.As<Function>();
+      }
+      return kind;
     }
 
-    bool HasSymbols(Local<Context> context, Local<Object> object) {
-      auto keys = GetAllPropertyNames(context, object);
+    /**
+     * Whether a plain object has symbol keys or values. `visited` may hold
+     * its enumerable string keys, if the caller has listed them already.
+     */
+    bool HasSymbols(
+      Local<Context> context,
+      Local<Object> object,
+      Local<Array> visited = Local<Array>()) {
+      Local<Array> keys;
+      if (_optimistic) {
+        // V8 and the encoder report symbol values as clone errors, but only
+        // visit enumerable string keys. If those are all there is, there is
+        // no need to look at the values here. No filter selects the other
+        // keys, so all of them are counted.
+        keys = GetAllPropertyNames(context, object);
+        if (
+          (!visited.IsEmpty() ||
+           object
+             ->GetPropertyNames(
+               context,
+               v8::KeyCollectionMode::kOwnOnly,
+               static_cast<v8::PropertyFilter>(
+                 v8::PropertyFilter::ONLY_ENUMERABLE |
+                 v8::PropertyFilter::SKIP_SYMBOLS),
+               v8::IndexFilter::kIncludeIndices)
+             .ToLocal(&visited)) &&
+          visited->Length() == keys->Length()) {
+          return false;
+        }
+      } else {
+        // Symbol keys are listed on their own, without materializing the
+        // other keys.
+        Local<Array> symbols;
+        if (
+          !object
+             ->GetPropertyNames(
+               context,
+               v8::KeyCollectionMode::kOwnOnly,
+               v8::PropertyFilter::SKIP_STRINGS,
+               v8::IndexFilter::kSkipIndices)
+             .ToLocal(&symbols) ||
+          symbols->Length() > 0) {
+          return true;
+        }
+        keys = GetAllPropertyNames(context, object);
+      }
       for (unsigned int i = 0; i < keys->Length(); ++i) {
         Local<Value> key = keys->Get(context, i).ToLocalChecked();
         Local<Value> value = object->Get(context, key).ToLocalChecked();
@@ -125,53 +380,35 @@ namespace delegate {
 
     virtual Maybe<bool> IsHostObject(
       Isolate* isolate, Local<Object> value) override {
+      return IsHostObject(isolate, value, Local<Array>());
+    }
+
+    /**
+     * `IsHostObject` for callers that have listed the enumerable string keys
+     * of `value` already, if it is a plain object.
+     */
+    Maybe<bool> IsHostObject(
+      Isolate* isolate, Local<Object> value, Local<Array> visited) {
       Local<Context> context = isolate->GetCurrentContext();
-      if (HasSymbols(
-            context,
-            value)) { // Special handling for objects with symbols
-        return Just(true);
-      }
-#ifdef SERIALISM_DEBUG
-      std::cout << "[Serializer] Checking if value `"
-                << *Nan::Utf8String(value->GetConstructorName())
-                << "` is a host object, registery has "
-                << _registeredClasses->Size() << " classes" << std::endl;
-#endif
-      auto globalObject = context->Global()
-                            ->Get(context, Nan::New("Object").ToLocalChecked())
-                            .ToLocalChecked()
-                            .As<Object>();
-      if (
-        value->Get(context, Nan::New("constructor").ToLocalChecked())
-          .ToLocalChecked()
-          ->StrictEquals(globalObject) ||
-        value->GetPrototype()->StrictEquals(globalObject->GetPrototype())) {
-#ifdef SERIALISM_DEBUG
-        std::cout
-          << "[Serializer] Value is not a host object, prototype is Object."
-          << std::endl;
-#endif
-        // If the prototype is Object, we check if it has a constructor
-        return Just(false); // Not a host object
-      }
-      auto found = MatchHostObjectConstructor(isolate, value);
-      if (found.IsEmpty()) {
-// No matching constructor found
-#ifdef SERIALISM_DEBUG
-        std::cout << "[Serializer] No matching constructor found for object."
-                  << std::endl;
-#endif
-        isolate->ThrowError(
-          String::Concat(
-            isolate,
-            Nan::New("No registered class found for ").ToLocalChecked(),
-            value->GetConstructorName()));
-        return Just(false); // Not a host object
+      switch (Classify(isolate, value)) {
+        case ClassKind::kRegistered:
+          return Just(true);
+        case ClassKind::kPlain:
+          // Plain objects with symbols are written as host objects.
+          return Just(HasSymbols(context, value, visited));
+        case ClassKind::kUnregistered:
+          break;
       }
 #ifdef SERIALISM_DEBUG
-      std::cout << "[Serializer] Value is a host object." << std::endl;
+      std::cout << "[Serializer] No matching constructor found for object."
+                << std::endl;
 #endif
-      return Just(true); // It is a host object
+      isolate->ThrowError(
+        String::Concat(
+          isolate,
+          Nan::New("No registered class found for ").ToLocalChecked(),
+          value->GetConstructorName()));
+      return Just(false); // Not a host object
     }
 
     Maybe<bool> WriteKey(Isolate* isolate, Local<Value> key) {
@@ -224,6 +461,14 @@ namespace delegate {
             .ToLocalChecked());
         return Nothing<bool>();
       }
+      uint32_t entry;
+      if (
+        keyKind == CustomHostKeyKind::kString &&
+        FindEntry(context, _dictionary, key, &entry)) {
+        _serializer->WriteUint32(static_cast<uint32_t>(kEntry));
+        _serializer->WriteUint32(entry);
+        return Just(true);
+      }
       _serializer->WriteUint32(static_cast<uint32_t>(keyKind));
       return _serializer->WriteValue(context, key);
     }
@@ -271,6 +516,29 @@ namespace delegate {
       return _serializer->WriteValue(context, value);
     }
 
+    /**
+     * Resolve the class name written for a host object: `undefined` for
+     * objects without a class, otherwise the name of its registered class.
+     */
+    MaybeLocal<Value> GetHostClassName(Isolate* isolate, Local<Object> object) {
+      Local<Function> registered;
+      switch (Classify(isolate, object, &registered)) {
+        case ClassKind::kPlain:
+          return Nan::Undefined();
+        case ClassKind::kRegistered:
+          return registered->GetName();
+        case ClassKind::kUnregistered:
+          break;
+      }
+#ifdef SERIALISM_DEBUG
+      std::cout << "[Serializer] No constructor found for host object."
+                << std::endl;
+#endif
+      isolate->ThrowError(
+        Nan::New("No constructor found for object").ToLocalChecked());
+      return MaybeLocal<Value>();
+    }
+
     virtual Maybe<bool> WriteHostObject(
       Isolate* isolate, Local<Object> object) override {
       auto context = isolate->GetCurrentContext();
@@ -281,67 +549,38 @@ namespace delegate {
         isolate->ThrowError(Nan::New("Serializer is not set").ToLocalChecked());
         return Nothing<bool>();
       }
-      auto maybeConstructor =
-        object->Get(context, Nan::New("constructor").ToLocalChecked());
-      if (!maybeConstructor.IsEmpty()) {
-        auto constructor = maybeConstructor.ToLocalChecked();
-        if (
-          constructor->IsNull() ||
-          constructor->StrictEquals( // Check if constructor is Object
-            context->Global()
-              ->Get(context, Nan::New("Object").ToLocalChecked())
-              .ToLocalChecked())) {
-          // If the constructor is null or undefined, we write a null value
-#ifdef SERIALISM_DEBUG
-          std::cout << "[Serializer] Null constructor found for host object."
-                    << std::endl;
-#endif
-          _serializer->WriteValue(context, Nan::Undefined())
-            .Check(); // Write null if no constructor is found
-        } else {
-          // Get the constructor for the host object
-          auto matchedConstructor = MatchHostObjectConstructor(isolate, object);
-          if (matchedConstructor.IsEmpty()) {
-#ifdef SERIALISM_DEBUG
-            std::cout << "[Serializer] No constructor found for host object."
-                      << std::endl;
-#endif
-            isolate->ThrowError(
-              Nan::New("No constructor found for object").ToLocalChecked());
-            return Nothing<bool>();
-          }
-          auto constructor = matchedConstructor.ToLocalChecked();
-          auto className = constructor->GetName();
-#ifdef SERIALISM_DEBUG
-          std::cout << "[Serializer] Found constructor for host object: "
-                    << *Nan::Utf8String(className) << std::endl;
-#endif
-          // Write the constructor's name to the serializer
-          if (auto res = _serializer->WriteValue(context, className);
-              !res.FromMaybe(false)) {
-#ifdef SERIALISM_DEBUG
-            std::cout
-              << "[Serializer] Failed to write host object constructor data."
-              << std::endl;
-#endif
-            isolate->ThrowError(
-              Nan::New("Failed to write host object constructor data")
-                .ToLocalChecked());
-            return res;
-          }
-        }
-      } else {
+      Local<Value> className;
+      if (!GetHostClassName(isolate, object).ToLocal(&className)) {
+        return Nothing<bool>();
+      }
+      // Write the constructor's name, or its dictionary entry, to the
+      // serializer
+      uint32_t entry;
+      Local<Value> written = className;
+      if (FindEntry(context, _dictionary, className, &entry)) {
+        written = Integer::NewFromUnsigned(isolate, entry);
+      }
+      if (auto res = _serializer->WriteValue(context, written);
+          !res.FromMaybe(false)) {
 #ifdef SERIALISM_DEBUG
-        std::cout << "[Serializer] No constructor found for host object"
-                  << std::endl;
+        std::cout
+          << "[Serializer] Failed to write host object constructor data."
+          << std::endl;
 #endif
-        // If no constructor is found, we write an null value
-        _serializer->WriteValue(context, Nan::Null()).Check();
+        isolate->ThrowError(
+          Nan::New("Failed to write host object constructor data")
+            .ToLocalChecked());
+        return res;
       }
 #ifdef SERIALISM_DEBUG
       std::cout << "[Serializer] Writing host object." << std::endl;
 #endif
-      auto keys = GetAllPropertyNames(context, object);
+      Local<Array> keys;
+      if (!GetHostPropertyNames(
+             context, object, GetClassFields(context, className))
+             .ToLocal(&keys)) {
+        return Nothing<bool>();
+      }
 
       _serializer->WriteUint32(keys->Length());
 
@@ -379,6 +618,8 @@ namespace delegate {
   class DeserializeDelegate: public ValueDeserializer::Delegate {
       private:
     Local<Map> _registeredClasses;
+    // Shared dictionary entries, if the payload uses a dictionary
+    Local<Array> _dictionary;
     ValueDeserializer* _deserializer = nullptr;
 
       public:
@@ -389,6 +630,25 @@ namespace delegate {
       this->_deserializer = deserializer;
     }
 
+    /**
+     * Resolve the dictionary entries that class names and keys refer to.
+     */
+    void UseDictionary(Local<Array> entries) {
+      _dictionary = entries;
+    }
+
+    /**
+     * Get shared dictionary entry `index`, throwing if there is none.
+     */
+    bool GetEntry(Isolate* isolate, uint32_t index, Local<Value>* out) {
+      if (_dictionary.IsEmpty() || index >= _dictionary->Length()) {
+        isolate->ThrowError("Unknown dictionary entry");
+        return false;
+      }
+      return _dictionary->Get(isolate->GetCurrentContext(), index)
+        .ToLocal(out);
+    }
+
     MaybeLocal<Function> GetHostObjectConstructorByName(
       Isolate* isolate, Local<String> className) {
       const Local<Array> array = _registeredClasses->AsArray();
@@ -450,9 +710,10 @@ namespace delegate {
             break;
           }
         case static_cast<uint32_t>(kNumber):
-          { // Read a number key
-            double number;
-            if (!_deserializer->ReadDouble(&number)) {
+          { // Number keys are written as regular values by WriteKey.
+            if (
+              !_deserializer->ReadValue(context).ToLocal(key) ||
+              !(*key)->IsNumber()) {
 #ifdef SERIALISM_DEBUG
               std::cerr << "[Deserializer] Failed to read number key."
                         << std::endl;
@@ -460,7 +721,18 @@ namespace delegate {
               isolate->ThrowError("Failed to read number key");
               return false;
             }
-            *key = Nan::New(number);
+            break;
+          }
+        case static_cast<uint32_t>(kEntry):
+          {
+            uint32_t index;
+            if (!_deserializer->ReadUint32(&index)) {
+              isolate->ThrowError("Failed to read dictionary entry");
+              return false;
+            }
+            if (!GetEntry(isolate, index, key)) {
+              return false;
+            }
             break;
           }
         default: isolate->ThrowError("Unknown key kind"); return false;
@@ -566,19 +838,19 @@ namespace delegate {
       auto className = maybeClassName.ToLocalChecked();
       auto object = Object::New(isolate);
 
+      if (
+        className->IsUint32() && !_dictionary.IsEmpty() &&
+        !GetEntry(isolate, className.As<Uint32>()->Value(), &className)) {
+        return MaybeLocal<Object>();
+      }
+
       if (className->IsUndefined()) {
 #ifdef SERIALISM_DEBUG
         std::cout << "[Deserializer] Class name is undefined, creating empty "
                      "object."
                   << std::endl;
 #endif
-        object
-          ->SetPrototype(
-            context,
-            context->Global()
-              ->Get(context, Nan::New("Object").ToLocalChecked())
-              .ToLocalChecked())
-          .Check(); // Set the prototype to Object
+        // Object::New already uses Object.prototype as the prototype.
       } else if (className->IsNull()) {
 #ifdef SERIALISM_DEBUG
         std::cout << "[Deserializer] Class name is null, creating empty object."
@@ -681,108 +953,3275 @@ namespace delegate {
   };
 } // namespace delegate
 
-bool checkIsSerialism(Local<Context> context, Local<Object> thisObject) {
-  auto marker =
-    thisObject->GetInternalField(InternalFields::kSerialismInstance);
-  if (
-    marker.IsEmpty() || !marker->IsValue() ||
-    !marker.As<String>()->StrictEquals(
-      Nan::New("SerialismInstance").ToLocalChecked())) {
-    // If the marker is not set or does not match, we throw an error.
-#ifdef SERIALISM_DEBUG
-    std::cerr << "[Serialism] This object is not an instance of Serialism."
-              << std::endl;
-#endif
-    Isolate* isolate = context->GetIsolate();
-    isolate->ThrowError(
-      "This object is not an instance of Serialism. Please create a new "
-      "instance of Serialism before using its methods.");
-    return false;
-  }
-  return true;
-}
-
-/**
- * Register a javascript class for serialization/deserialization.
- */
-NAN_METHOD(registerClass) {
-  Local<Context> ctx = Nan::GetCurrentContext();
-  Isolate* isolate = ctx->GetIsolate();
-  Local<Context> context = isolate->GetCurrentContext();
-  HandleScope scope(isolate);
+namespace cloning {
+  /**
+   * Deep-copies a value graph directly, producing the same result as
+   * deserializing its serialized form without the intermediate buffer.
+   *
+   * Containers are created empty when first reached and filled from a work
+   * list, so cycles and shared references resolve through the identity map
+   * and the native stack does not grow with the depth of the graph.
+   * Primitives, including strings and symbols, are shared with the source.
+   */
+  class Cloner {
+      private:
+    enum class Fill : uint8_t {
+      kEnumerable, // Own enumerable string keys (plain objects, arrays)
+      kAll,        // All own properties (host objects)
+      kMap,        // Map entries
+      kSet,        // Set values
+    };
 
-  if (!checkIsSerialism(context, info.This())) {
-    return; // If the object is not a Serialism instance, we throw an error.
-  }
+    struct Pending {
+      Fill fill;
+      Local<Object> source;
+      Local<Object> target;
+      Local<Value> fields; // Fields registered for the class of a host object
+    };
 
-  auto count = info.Length();
+    Isolate* _isolate;
+    Local<Context> _context;
+    delegate::SerializeDelegate _classifier;
+    Local<Map> _copies;
+    std::vector<Pending> _pending;
 
-  Local<Map> classes =
-    info.This()->GetInternalField(InternalFields::kKnownClasses).As<Map>();
+      public:
+    Cloner(Isolate* isolate, Local<Map> classes, Local<Map> fields):
+      _isolate(isolate),
+      _context(isolate->GetCurrentContext()),
+      _classifier(isolate, classes, fields),
+      _copies(Map::New(isolate)) {}
 
-  for (int i = 0; i < count; ++i) {
-    if (!info[i]->IsFunction()) {
-      isolate->ThrowError("All arguments must be constructor functions");
-      return;
+    MaybeLocal<Value> Clone(Local<Value> value) {
+      Local<Value> result;
+      if (!CopyValue(value).ToLocal(&result)) {
+        return MaybeLocal<Value>();
+      }
+      while (!_pending.empty()) {
+        Pending pending = _pending.back();
+        _pending.pop_back();
+        if (!FillObject(pending)) {
+          return MaybeLocal<Value>();
+        }
+      }
+      return result;
     }
 
-    auto arg = info[i];
-
-    if (!arg->IsFunction()) {
-      isolate->ThrowError("Argument must be a class");
-      return;
+      private:
+    void ThrowCloneError(Local<Object> object) {
+      _classifier.ThrowDataCloneError(
+        String::Concat(
+          _isolate,
+          String::Concat(
+            _isolate,
+            Nan::New("<").ToLocalChecked(),
+            object->GetConstructorName()),
+          Nan::New("> could not be cloned.").ToLocalChecked()));
     }
 
-    Local<Function> constructor = arg.As<Function>();
-
-    if (!constructor->IsConstructor()) {
-      Nan::ThrowError("Argument must be a class");
-      return;
+    // Symbols are rejected outside of host objects, as V8 does.
+    void ThrowSymbolCloneError(Local<Value> symbol) {
+      Local<String> detail;
+      if (!symbol->ToDetailString(_context).ToLocal(&detail)) {
+        return;
+      }
+      _classifier.ThrowDataCloneError(
+        String::Concat(
+          _isolate,
+          detail,
+          Nan::New(" could not be cloned.").ToLocalChecked()));
     }
 
-    // Register the constructor for serialization.
-
-    auto name = constructor->GetName();
+    /**
+     * Copy a symbol key or value of a host object the way it comes out of a
+     * round trip: as the global symbol with the same description.
+     */
+    bool CopySymbol(Local<Value> value, Local<Value>* out) {
+      Local<Value> description = value->IsSymbolObject()
+        ? value.As<SymbolObject>()->ValueOf()->Description(_isolate)
+        : value.As<Symbol>()->Description(_isolate);
+      if (description.IsEmpty() || !description->IsString()) {
+        _isolate->ThrowError(
+          Nan::New("Failed to serialize a non-serializable value: Symbol")
+            .ToLocalChecked());
+        return false;
+      }
+      *out = Symbol::For(_isolate, description.As<String>());
+      return true;
+    }
 
-    if (
-      name.IsEmpty() || !name->IsString() || name.As<String>()->Length() == 0) {
-      isolate->ThrowError("Class must have a name");
-      return;
+    // Record a copy and schedule its contents to be filled in.
+    Local<Object> Track(
+      Local<Object> source,
+      Local<Object> target,
+      Fill fill,
+      Local<Value> fields = Local<Value>()) {
+      _copies->Set(_context, source, target).ToLocalChecked();
+      _pending.push_back(Pending {fill, source, target, fields});
+      return target;
     }
 
-    if (arg->IsProxy()) {
-      isolate->ThrowError("Cannot register a proxy as a class");
-      return;
+    Local<Object> Remember(Local<Object> source, Local<Object> target) {
+      _copies->Set(_context, source, target).ToLocalChecked();
+      return target;
     }
 
-    if (classes->Has(ctx, name).FromJust()) {
-      if (classes->Get(ctx, name).ToLocalChecked()->StrictEquals(constructor)) {
-        // If the class is already registered, we skip it.
-        continue;
-      } else { // If two different classes share the same name, throw an error.
-        isolate->ThrowError(
-          String::Concat(
-            isolate,
-            String::Concat(
-              isolate,
-              Nan::New("A different class with the name '").ToLocalChecked(),
-              name.As<String>()),
-            Nan::New("' is already registered.").ToLocalChecked()));
-        return;
+    MaybeLocal<Value> CopyValue(Local<Value> value) {
+      if (value->IsSymbol() || value->IsSymbolObject()) {
+        ThrowSymbolCloneError(value);
+        return MaybeLocal<Value>();
+      }
+      if (!value->IsObject()) {
+        return value; // Primitives are immutable and can be shared.
+      }
+      auto object = value.As<Object>();
+      Local<Value> existing;
+      if (!_copies->Get(_context, object).ToLocal(&existing)) {
+        return MaybeLocal<Value>();
+      }
+      if (!existing->IsUndefined()) {
+        return existing;
+      }
+      if (
+        object->IsFunction() || object->IsProxy() ||
+        object->IsSharedArrayBuffer() || object->IsWeakMap() ||
+        object->IsWeakSet() || object->IsPromise() ||
+        object->IsGeneratorObject() || object->IsModuleNamespaceObject() ||
+        object->IsMapIterator() || object->IsSetIterator() ||
+        object->IsWasmModuleObject() || object->IsExternal()) {
+        ThrowCloneError(object);
+        return MaybeLocal<Value>();
       }
+      if (object->IsArray()) {
+        return Track(
+          object,
+          Array::New(_isolate, object.As<Array>()->Length()),
+          Fill::kEnumerable);
+      }
+      if (object->IsMap()) {
+        return Track(object, Map::New(_isolate), Fill::kMap);
+      }
+      if (object->IsSet()) {
+        return Track(object, Set::New(_isolate), Fill::kSet);
+      }
+      if (object->IsDate()) {
+        Local<Value> date;
+        if (!Date::New(_context, object.As<Date>()->ValueOf()).ToLocal(&date)) {
+          return MaybeLocal<Value>();
+        }
+        return Remember(object, date.As<Object>());
+      }
+      if (object->IsRegExp()) {
+        auto regexp = object.As<RegExp>();
+        Local<RegExp> copy;
+        if (!RegExp::New(_context, regexp->GetSource(), regexp->GetFlags())
+               .ToLocal(&copy)) {
+          return MaybeLocal<Value>();
+        }
+        return Remember(object, copy);
+      }
+      if (object->IsBooleanObject()) {
+        return Remember(
+          object,
+          BooleanObject::New(_isolate, object.As<BooleanObject>()->ValueOf())
+            .As<Object>());
+      }
+      if (object->IsNumberObject()) {
+        return Remember(
+          object,
+          NumberObject::New(_isolate, object.As<NumberObject>()->ValueOf())
+            .As<Object>());
+      }
+      if (object->IsStringObject()) {
+        return Remember(
+          object,
+          StringObject::New(_isolate, object.As<StringObject>()->ValueOf())
+            .As<Object>());
+      }
+      if (object->IsBigIntObject()) {
+        Local<Value> primitive = object.As<BigIntObject>()->ValueOf();
+        Local<Object> copy;
+        if (!primitive->ToObject(_context).ToLocal(&copy)) {
+          return MaybeLocal<Value>();
+        }
+        return Remember(object, copy);
+      }
+      if (object->IsArrayBuffer()) {
+        auto buffer = object.As<ArrayBuffer>();
+        auto copy = ArrayBuffer::New(_isolate, buffer->ByteLength());
+        if (buffer->ByteLength() > 0) {
+          std::memcpy(copy->Data(), buffer->Data(), buffer->ByteLength());
+        }
+        return Remember(object, copy);
+      }
+      if (object->IsArrayBufferView()) {
+        return CopyArrayBufferView(object.As<ArrayBufferView>());
+      }
+      return CopyObject(object);
     }
 
-    String::Utf8Value utf8Value(isolate, name);
+    MaybeLocal<Value> CopyArrayBufferView(Local<ArrayBufferView> view) {
+      // Views share their copied buffer, just like serialized views do.
+      Local<Value> maybeBuffer;
+      if (!CopyValue(view->Buffer()).ToLocal(&maybeBuffer)) {
+        return MaybeLocal<Value>();
+      }
+      auto buffer = maybeBuffer.As<ArrayBuffer>();
+      size_t offset = view->ByteOffset();
+      size_t length = view->ByteLength();
+      Local<Object> copy;
+      if (view->IsDataView()) {
+        copy = DataView::New(buffer, offset, length);
+      } else if (view->IsUint8Array()) {
+        copy = Uint8Array::New(buffer, offset, length);
+      } else if (view->IsUint8ClampedArray()) {
+        copy = Uint8ClampedArray::New(buffer, offset, length);
+      } else if (view->IsInt8Array()) {
+        copy = Int8Array::New(buffer, offset, length);
+      } else if (view->IsUint16Array()) {
+        copy = Uint16Array::New(buffer, offset, length / 2);
+      } else if (view->IsInt16Array()) {
+        copy = Int16Array::New(buffer, offset, length / 2);
+      } else if (view->IsUint32Array()) {
+        copy = Uint32Array::New(buffer, offset, length / 4);
+      } else if (view->IsInt32Array()) {
+        copy = Int32Array::New(buffer, offset, length / 4);
+      } else if (view->IsFloat32Array()) {
+        copy = Float32Array::New(buffer, offset, length / 4);
+      } else if (view->IsFloat64Array()) {
+        copy = Float64Array::New(buffer, offset, length / 8);
+      } else if (view->IsBigInt64Array()) {
+        copy = BigInt64Array::New(buffer, offset, length / 8);
+      } else if (view->IsBigUint64Array()) {
+        copy = BigUint64Array::New(buffer, offset, length / 8);
+      } else {
+        ThrowCloneError(view);
+        return MaybeLocal<Value>();
+      }
+      return Remember(view, copy);
+    }
+
+    MaybeLocal<Value> CopyObject(Local<Object> object) {
+      bool isHost;
+      {
+        // IsHostObject reports unregistered classes by throwing.
+        HandleScope scope(_isolate);
+        v8::TryCatch tryCatch(_isolate);
+        isHost = _classifier.IsHostObject(_isolate, object).FromMaybe(false);
+        if (tryCatch.HasCaught()) {
+          tryCatch.ReThrow();
+          return MaybeLocal<Value>();
+        }
+      }
+      auto copy = Object::New(_isolate);
+      if (!isHost) {
+        return Track(object, copy, Fill::kEnumerable);
+      }
+      Local<Value> fields;
+      // Resolve the prototype the same way WriteHostObject and
+      // ReadHostObject do.
+      Local<Function> registered;
+      auto kind = _classifier.Classify(_isolate, object, &registered);
+      if (kind == delegate::ClassKind::kUnregistered) {
+        _isolate->ThrowError(
+          Nan::New("No constructor found for object").ToLocalChecked());
+        return MaybeLocal<Value>();
+      }
+      if (kind == delegate::ClassKind::kRegistered) {
+        Local<Value> proto;
+        if (
+          !registered->Get(_context, Nan::New("prototype").ToLocalChecked())
+             .ToLocal(&proto) ||
+          !proto->IsObject()) {
+          proto = registered->GetPrototype();
+        }
+        if (!copy->SetPrototype(_context, proto).FromMaybe(false)) {
+          return MaybeLocal<Value>();
+        }
+        fields = _classifier.GetClassFields(_context, registered->GetName());
+      }
+      return Track(object, copy, Fill::kAll, fields);
+    }
+
+    bool FillObject(const Pending& pending) {
+      switch (pending.fill) {
+        case Fill::kMap:
+          {
+            auto entries = pending.source.As<Map>()->AsArray();
+            auto target = pending.target.As<Map>();
+            for (uint32_t i = 0; i + 1 < entries->Length(); i += 2) {
+              Local<Value> key, value;
+              if (
+                !CopyEntry(entries, i, &key) ||
+                !CopyEntry(entries, i + 1, &value) ||
+                target->Set(_context, key, value).IsEmpty()) {
+                return false;
+              }
+            }
+            return true;
+          }
+        case Fill::kSet:
+          {
+            auto values = pending.source.As<Set>()->AsArray();
+            auto target = pending.target.As<Set>();
+            for (uint32_t i = 0; i < values->Length(); ++i) {
+              Local<Value> value;
+              if (
+                !CopyEntry(values, i, &value) ||
+                target->Add(_context, value).IsEmpty()) {
+                return false;
+              }
+            }
+            return true;
+          }
+        case Fill::kEnumerable:
+        case Fill::kAll:
+          {
+            Local<Array> keys;
+            if (pending.fill == Fill::kAll) {
+              if (!_classifier
+                     .GetHostPropertyNames(
+                       _context, pending.source, pending.fields)
+                     .ToLocal(&keys)) {
+                return false;
+              }
+            } else if (!pending.source
+                          ->GetPropertyNames(
+                            _context,
+                            KeyCollectionMode::kOwnOnly,
+                            static_cast<PropertyFilter>(
+                              PropertyFilter::ONLY_ENUMERABLE |
+                              PropertyFilter::SKIP_SYMBOLS),
+                            IndexFilter::kIncludeIndices)
+                          .ToLocal(&keys)) {
+              return false;
+            }
+            bool host = pending.fill == Fill::kAll;
+            for (uint32_t i = 0; i < keys->Length(); ++i) {
+              Local<Value> key, value, copy;
+              if (
+                !keys->Get(_context, i).ToLocal(&key) ||
+                !pending.source->Get(_context, key).ToLocal(&value) ||
+                (host && key->IsSymbol() && !CopySymbol(key, &key))) {
+                return false;
+              }
+              if (host && (value->IsSymbol() || value->IsSymbolObject())) {
+                if (!CopySymbol(value, &copy)) {
+                  return false;
+                }
+              } else if (!CopyValue(value).ToLocal(&copy)) {
+                return false;
+              }
+              // Host objects are populated like ReadHostObject does, other
+              // objects like V8's deserializer.
+              // Index keys are reported as numbers.
+              Maybe<bool> set = host
+                ? pending.target->Set(_context, key, copy)
+                : key->IsUint32()
+                ? pending.target->CreateDataProperty(
+                    _context, key.As<Uint32>()->Value(), copy)
+                : pending.target->CreateDataProperty(
+                    _context, key.As<Name>(), copy);
+              if (set.IsNothing()) {
+                return false;
+              }
+            }
+            return true;
+          }
+      }
+      return false;
+    }
+
+    bool CopyEntry(Local<Array> entries, uint32_t index, Local<Value>* out) {
+      Local<Value> value;
+      return entries->Get(_context, index).ToLocal(&value) &&
+        CopyValue(value).ToLocal(out);
+    }
+  };
+} // namespace cloning
+
+namespace traversal {
+  using serialism::format::HostClass;
+  using serialism::format::StringEncoding;
+  using serialism::format::StringView;
+  using serialism::format::Token;
+  using serialism::format::TokenType;
+  using serialism::wire::ArrayBufferViewTag;
+  using serialism::wire::ErrorTag;
+
+  /**
+   * List the indices of the elements present in `array`, in order.
+   */
+  bool ListElements(
+    Local<Context> context,
+    Local<Array> array,
+    std::vector<uint32_t>* indices) {
+    indices->clear();
+    auto visit = [](uint32_t index, Local<Value>, void* data) {
+      static_cast<std::vector<uint32_t>*>(data)->push_back(index);
+      return Array::CallbackResult::kContinue;
+    };
+    // Holes are skipped. The elements of arrays in dictionary mode may
+    // not be visited in order.
+    if (array->Iterate(context, visit, indices).IsNothing()) {
+      return false;
+    }
+    if (!std::is_sorted(indices->begin(), indices->end())) {
+      std::sort(indices->begin(), indices->end());
+    }
+    return true;
+  }
+
+  /**
+   * Maps objects to the ids they were written with, keyed by their identity
+   * hash in an open-addressed table. Computing the hash is the costly part,
+   * so the hash of the last object looked up is reused when it is inserted.
+   */
+  class IdentityMap {
+      public:
+    bool Find(Local<Object> object, uint32_t* id) {
+      _lastObject = object;
+      _lastHash = object->GetIdentityHash();
+      if (_entries.empty()) {
+        return false;
+      }
+      size_t mask = _entries.size() - 1;
+      for (size_t i = Slot(_lastHash);; i = (i + 1) & mask) {
+        const Entry& entry = _entries[i];
+        if (entry.object.IsEmpty()) {
+          return false;
+        }
+        if (entry.hash == _lastHash && entry.object == object) {
+          *id = entry.id;
+          return true;
+        }
+      }
+    }
+
+    void Insert(Local<Object> object, uint32_t id) {
+      int hash =
+        object == _lastObject ? _lastHash : object->GetIdentityHash();
+      if ((_size + 1) * 4 > _entries.size() * 3) {
+        Grow();
+      }
+      Place(Entry {object, hash, id});
+      ++_size;
+    }
+
+      private:
+    struct Entry {
+      Local<Object> object;
+      int hash;
+      uint32_t id;
+    };
+
+    std::vector<Entry> _entries;
+    size_t _size = 0;
+    Local<Object> _lastObject;
+    int _lastHash = 0;
+
+    size_t Slot(int hash) const {
+      // Identity hashes are random, so the low bits are well distributed.
+      return static_cast<uint32_t>(hash) & (_entries.size() - 1);
+    }
+
+    void Place(const Entry& entry) {
+      size_t mask = _entries.size() - 1;
+      size_t i = Slot(entry.hash);
+      while (!_entries[i].object.IsEmpty()) {
+        i = (i + 1) & mask;
+      }
+      _entries[i] = entry;
+    }
+
+    void Grow() {
+      std::vector<Entry> entries(_entries.empty() ? 64 : _entries.size() * 2);
+      entries.swap(_entries);
+      for (const Entry& entry : entries) {
+        if (!entry.object.IsEmpty()) {
+          Place(entry);
+        }
+      }
+    }
+  };
+
+  /**
+   * Serializes a value with an explicit stack of open containers instead of
+   * recursing through `ValueSerializer` and the delegate, so the depth of a
+   * graph is bounded by heap memory rather than by the native stack.
+   *
+   * Values are classified by `SerializeDelegate` and written in the same
+   * order and with the same object ids as the recursive serializer, so
+   * either deserializer can read the output.
+   */
+  template <typename Sink>
+  class Encoder {
+      public:
+    Encoder(
+      Isolate* isolate,
+      Local<Map> classes,
+      Local<Map> fields,
+      Sink sink = Sink()):
+      _isolate(isolate),
+      _context(isolate->GetCurrentContext()),
+      _classifier(isolate, classes, fields),
+      _writer(std::move(sink)) {}
+
+    /**
+     * Write the header followed by `value`. Returns false with an exception
+     * pending if the value cannot be serialized.
+     */
+    bool Encode(Local<Value> value) {
+      {
+        v8::TryCatch tryCatch(_isolate);
+        _classifier.Optimistic();
+        if (EncodeOnce(value)) {
+          return true;
+        }
+        if (!_classifier.symbolError() || !tryCatch.CanContinue()) {
+          if (tryCatch.HasCaught()) {
+            tryCatch.ReThrow();
+          }
+          return false;
+        }
+      }
+      // A symbol value in a plain object that was not scanned for them
+      // fails the first try, so start over scanning every plain object.
+      // Getters run again, see the README.
+      _classifier.Precise();
+      Reset();
+      return EncodeOnce(value);
+    }
+
+    /**
+     * Collect the items of the array, map or set `source` so that runs of
+     * them can be written with `EncodeRun`. The items are shared by every
+     * run, so this must be called in a handle scope that outlives them.
+     */
+    bool BeginRuns(Local<Object> source) {
+      _run = Run();
+      _run.source = source;
+      if (source->IsMap()) {
+        _run.items = source.As<Map>()->AsArray();
+        _run.stride = 2;
+        return true;
+      }
+      if (source->IsSet()) {
+        _run.items = source.As<Set>()->AsArray();
+        return true;
+      }
+      // Only the elements that are present are visited, so sparse arrays
+      // of any length cost as much as their elements.
+      auto array = source.As<Array>();
+      if (!ListElements(_context, array, &_run.indices)) {
+        return false;
+      }
+      _run.dense = _run.indices.size() == array->Length();
+      _run.doubles = _run.dense && HasDoubleElements(array);
+      if (_run.dense) {
+        _run.indices = std::vector<uint32_t>();
+      }
+      return true;
+    }
+
+    /**
+     * Write the header followed by a container of the same kind as the
+     * source given to `BeginRuns`, holding its items [begin, end): the
+     * elements of an array or the entries of a map or set. Other properties
+     * are not written. The output of the previous run must have been taken
+     * from the sink.
+     */
+    bool EncodeRun(uint32_t begin, uint32_t end) {
+      Reset();
+      _run.begin = begin;
+      _run.end = end;
+      _run.active = true;
+      bool encoded = Encode(_run.source);
+      _run.active = false;
+      return encoded;
+    }
+
+    Sink& sink() {
+      return _writer.sink();
+    }
+
+    /**
+     * Tally the bytes written for instances of each registered class, by
+     * class name. Bytes count toward the innermost instance being written,
+     * so nested instances are not included in their parent's total.
+     */
+    void CountClasses() {
+      _countClasses = true;
+    }
+
+    const std::unordered_map<std::string, size_t>& classSizes() const {
+      return _classSizes;
+    }
+
+    /**
+     * Write logically equal values as the same bytes: keys, map entries and
+     * set values are sorted, and strings are written as one-byte strings
+     * whenever they can be.
+     */
+    void Canonical() {
+      _canonical = true;
+    }
+
+    /**
+     * Write the class names and string keys of host objects that are in
+     * shared dictionary `id` as the indexes of its entries in `indexes`.
+     */
+    void UseDictionary(uint32_t id, Local<Map> indexes) {
+      _dictionaryId = id;
+      _dictionary = indexes;
+    }
+
+      private:
+    bool EncodeOnce(Local<Value> value) {
+      if (_dictionary.IsEmpty()) {
+        _writer.WriteHeader();
+      } else {
+        _writer.WriteHeader(_dictionaryId);
+      }
+      if (!(_run.active ? WriteRun() : WriteValue(value))) {
+        return false;
+      }
+      while (!_stack.empty()) {
+        if (!Step()) {
+          return false;
+        }
+      }
+      if (!_writer.ok()) {
+        Nan::ThrowError(
+          _writer.error() ? _writer.error()
+                          : "Could not allocate memory for serialized data");
+        return false;
+      }
+      return true;
+    }
+
+    enum class FrameKind : uint8_t {
+      kObject,
+      kDenseArray,
+      kSparseArray,
+      kHost,
+      kMap,
+      kSet,
+    };
+
+    struct Frame {
+      FrameKind kind;
+      Local<Object> object;
+      Local<Array> items; // Property names, or map and set contents
+      uint32_t length;    // Number of items
+      uint32_t elements;  // Dense array length
+      uint32_t index;     // Next item
+      bool counted;       // Owns the innermost entry of `_owners`
+      bool doubles;       // Dense array elements are written as doubles
+      uint32_t offset;    // Subtracted from the indices of a sparse run
+    };
+
+    // The container `EncodeRun` writes runs of, and its items.
+    struct Run {
+      Local<Object> source;
+      Local<Array> items;            // Map or set contents
+      uint32_t stride = 1;           // Items per entry
+      std::vector<uint32_t> indices; // Elements of a holey array
+      bool dense = false;            // The array has no holes
+      bool doubles = false;          // Its elements are written as doubles
+      uint32_t begin = 0;
+      uint32_t end = 0;
+      bool active = false;
+    };
+
+    Isolate* _isolate;
+    Local<Context> _context;
+    delegate::SerializeDelegate _classifier;
+    serialism::format::BasicWriter<Sink> _writer;
+    IdentityMap _ids;
+    std::vector<Frame> _stack;
+    std::vector<uint64_t> _words;
+    std::vector<uint16_t> _chars; // See ViewString
+    bool _countClasses = false;
+    bool _canonical = false;
+    uint32_t _dictionaryId = 0;
+    Local<Map> _dictionary; // Shared dictionary entry indexes, if any
+    // The canonical order of some lists of property names, which are held
+    // across handle scopes.
+    struct OrderCacheEntry {
+      std::vector<Global<Value>> names;
+      std::vector<uint32_t> order;
+    };
+
+    static constexpr size_t kOrderCacheSize = 64;
+    std::vector<OrderCacheEntry> _orders =
+      std::vector<OrderCacheEntry>(kOrderCacheSize);
+    std::vector<uint32_t> _order; // Order of items that are not cached
+    std::unordered_map<std::string, size_t> _classSizes;
+    std::vector<size_t*> _owners; // Tallies of the enclosing instances
+    size_t _counted = 0;          // Output size when last attributed
+    Run _run;
+
+    // How an item compares in canonical order.
+    struct SortKey {
+      uint8_t rank; // Kind of value, in sort order
+      double number;
+      std::u16string text;
+      uint32_t index; // Position among the items being sorted
+    };
+
+    enum SortRank : uint8_t {
+      kUndefinedRank,
+      kNullRank,
+      kBooleanRank,
+      kNumberRank,
+      kStringRank,
+      kSymbolRank,
+      kOtherRank,
+    };
+
+    void ReadText(Local<String> string, std::u16string* out) {
+      out->resize(string->Length());
+      string->Write(
+        _isolate,
+        reinterpret_cast<uint16_t*>(out->data()),
+        0,
+        static_cast<int>(out->size()),
+        String::NO_NULL_TERMINATION);
+    }
+
+    SortKey Rank(Local<Value> value, uint32_t index) {
+      SortKey key {kOtherRank, 0, std::u16string(), index};
+      if (value->IsUndefined()) {
+        key.rank = kUndefinedRank;
+      } else if (value->IsNull()) {
+        key.rank = kNullRank;
+      } else if (value->IsBoolean()) {
+        key.rank = kBooleanRank;
+        key.number = value->IsTrue();
+      } else if (value->IsNumber()) {
+        key.rank = kNumberRank;
+        key.number = value.As<Number>()->Value();
+      } else if (value->IsString()) {
+        key.rank = kStringRank;
+        ReadText(value.As<String>(), &key.text);
+      } else if (value->IsSymbol()) {
+        Local<Value> description = value.As<Symbol>()->Description(_isolate);
+        if (description->IsString()) {
+          key.rank = kSymbolRank;
+          ReadText(description.As<String>(), &key.text);
+        }
+      }
+      return key;
+    }
+
+    static bool SortsBefore(const SortKey& a, const SortKey& b) {
+      if (a.rank != b.rank) {
+        return a.rank < b.rank;
+      }
+      if (a.rank == kBooleanRank || a.rank == kNumberRank) {
+        bool aNaN = std::isnan(a.number), bNaN = std::isnan(b.number);
+        return aNaN || bNaN ? !aNaN && bNaN : a.number < b.number;
+      }
+      return a.text < b.text;
+    }
+
+    /**
+     * Put property names, map entries (`stride` 2) or set values in
+     * canonical order, after the first `skip` items: undefined, null,
+     * booleans, numbers and strings by value, then symbols by description,
+     * then anything else in its original order. Strings are compared by
+     * UTF-16 code units, like `Array.prototype.sort`.
+     */
+    bool SortItems(
+      Local<Array>* items, uint32_t stride = 1, uint32_t skip = 0) {
+      EscapableHandleScope scope(_isolate);
+      uint32_t length = (*items)->Length();
+      std::vector<Local<Value>> values(length);
+      for (uint32_t i = 0; i < length; ++i) {
+        if (!(*items)->Get(_context, i).ToLocal(&values[i])) {
+          return false;
+        }
+      }
+      // Objects of a few shapes make up most graphs, so the order of
+      // property names is remembered by the names.
+      OrderCacheEntry* cached = nullptr;
+      if (stride == 1 && skip == 0) {
+        cached = FindOrder(values);
+      }
+      const std::vector<uint32_t>* order = cached ? &cached->order : &_order;
+      if (!cached || cached->names.empty()) {
+        std::vector<SortKey> keys;
+        keys.reserve((length - skip) / stride);
+        for (uint32_t i = skip; i < length; i += stride) {
+          keys.push_back(Rank(values[i], i));
+        }
+        std::stable_sort(keys.begin(), keys.end(), SortsBefore);
+        std::vector<uint32_t> computed;
+        computed.reserve(keys.size());
+        for (const SortKey& key : keys) {
+          computed.push_back(key.index);
+        }
+        if (cached) {
+          for (Local<Value> value : values) {
+            cached->names.emplace_back(_isolate, value);
+          }
+          cached->order = std::move(computed);
+        } else {
+          _order = std::move(computed);
+        }
+      }
+      bool sorted = true;
+      for (uint32_t i = 0; i < order->size() && sorted; ++i) {
+        sorted = (*order)[i] == skip + i * stride;
+      }
+      if (sorted) {
+        return true;
+      }
+      std::vector<Local<Value>> result(values.begin(), values.begin() + skip);
+      for (uint32_t index : *order) {
+        result.insert(
+          result.end(),
+          values.begin() + index,
+          values.begin() + index + stride);
+      }
+      *items = scope.Escape(Array::New(_isolate, result.data(), length));
+      return true;
+    }
+
+    // Find the cache entry for a list of property names. The entry is
+    // emptied and returned if it held other names, or if there are none
+    // when the names include numbers, which are not cached.
+    OrderCacheEntry* FindOrder(const std::vector<Local<Value>>& names) {
+      uint32_t hash = static_cast<uint32_t>(names.size());
+      for (Local<Value> name : names) {
+        if (!name->IsName()) {
+          return nullptr;
+        }
+        hash = hash * 31 + name.As<Name>()->GetIdentityHash();
+      }
+      OrderCacheEntry& entry = _orders[hash % kOrderCacheSize];
+      bool same = entry.names.size() == names.size();
+      for (size_t i = 0; i < names.size() && same; ++i) {
+        same = names[i]->StrictEquals(entry.names[i].Get(_isolate));
+      }
+      if (!same) {
+        entry.names.clear();
+      }
+      return &entry;
+    }
+
+    // Charge the output written since the last call to the innermost
+    // registered instance.
+    void Attribute() {
+      size_t size = _writer.sink().size();
+      if (!_owners.empty()) {
+        *_owners.back() += size - _counted;
+      }
+      _counted = size;
+    }
+
+    void ThrowCloneError(Local<Value> value) {
+      Local<String> detail;
+      if (!value->ToDetailString(_context).ToLocal(&detail)) {
+        return;
+      }
+      _classifier.ThrowCloneError(
+        String::Concat(
+          _isolate,
+          detail,
+          Nan::New(" could not be cloned.").ToLocalChecked()),
+        value->IsSymbol() || value->IsSymbolObject());
+    }
+
+    void Push(
+      FrameKind kind,
+      Local<Object> object,
+      Local<Array> items,
+      uint32_t elements = 0) {
+      _stack.push_back(
+        Frame {
+          kind,
+          object,
+          items,
+          items->Length(),
+          elements,
+          0,
+          false,
+          false,
+          0});
+    }
+
+    // Forget what was written, to start over with an empty sink.
+    void Reset() {
+      _writer = serialism::format::BasicWriter<Sink>();
+      _ids = IdentityMap();
+      _stack.clear();
+      _classSizes.clear();
+      _owners.clear();
+      _counted = 0;
+    }
+
+    // Write the container of the current run and push it. References to
+    // the source from inside the run are written as references to it.
+    bool WriteRun() {
+      uint32_t begin = _run.begin, end = _run.end;
+      _ids.Insert(_run.source, _writer.nextId());
+      if (!_run.source->IsArray()) {
+        Local<Array> items = _run.items;
+        begin *= _run.stride;
+        end *= _run.stride;
+        if (_canonical) {
+          std::vector<Local<Value>> run(end - begin);
+          for (uint32_t i = begin; i < end; ++i) {
+            if (!items->Get(_context, i).ToLocal(&run[i - begin])) {
+              return false;
+            }
+          }
+          items = Array::New(_isolate, run.data(), run.size());
+          if (!SortItems(&items, _run.stride)) {
+            return false;
+          }
+          begin = 0;
+          end = items->Length();
+        }
+        FrameKind kind;
+        if (_run.stride == 2) {
+          _writer.BeginMap();
+          kind = FrameKind::kMap;
+        } else {
+          _writer.BeginSet();
+          kind = FrameKind::kSet;
+        }
+        _stack.push_back(
+          Frame {kind, _run.source, items, end, 0, begin, false, false, 0});
+        return true;
+      }
+      auto first =
+        std::lower_bound(_run.indices.begin(), _run.indices.end(), begin);
+      auto last = std::lower_bound(first, _run.indices.end(), end);
+      if (_run.dense || last - first == end - begin) {
+        _writer.BeginArray(end - begin);
+        _stack.push_back(
+          Frame {
+            FrameKind::kDenseArray,
+            _run.source,
+            Array::New(_isolate),
+            end,
+            end,
+            begin,
+            false,
+            _run.doubles,
+            0});
+        return true;
+      }
+      std::vector<Local<Value>> keys;
+      keys.reserve(last - first);
+      for (auto index = first; index != last; ++index) {
+        keys.push_back(Integer::NewFromUnsigned(_isolate, *index));
+      }
+      _writer.BeginArray(end - begin, true);
+      Push(
+        FrameKind::kSparseArray,
+        _run.source,
+        Array::New(_isolate, keys.data(), keys.size()));
+      _stack.back().offset = begin;
+      return true;
+    }
+
+    // Write the next item of the innermost container, or close it.
+    bool Step() {
+      Frame& frame = _stack.back();
+      if (frame.index == frame.length) {
+        bool ended = false;
+        switch (frame.kind) {
+          case FrameKind::kObject: ended = _writer.EndObject(); break;
+          case FrameKind::kDenseArray:
+          case FrameKind::kSparseArray: ended = _writer.EndArray(); break;
+          case FrameKind::kHost: ended = _writer.EndHostObject(); break;
+          case FrameKind::kMap: ended = _writer.EndMap(); break;
+          case FrameKind::kSet: ended = _writer.EndSet(); break;
+        }
+        if (frame.counted) {
+          Attribute();
+          _owners.pop_back();
+        }
+        _stack.pop_back();
+        if (!ended) {
+          Nan::ThrowError(_writer.error());
+        }
+        return ended;
+      }
+      // Writing an object may push a frame, so copy what is needed.
+      uint32_t index = frame.index++;
+      FrameKind kind = frame.kind;
+      Local<Object> object = frame.object;
+      Local<Array> items = frame.items;
+      bool element = kind == FrameKind::kDenseArray && index < frame.elements;
+      bool doubles = frame.doubles;
+      uint32_t offset = frame.offset;
+
+      Local<Value> value;
+      {
+        // Only objects outlive this step, as they are remembered by id.
+        EscapableHandleScope scope(_isolate);
+        Local<Value> item;
+        if (element) {
+          if (!object->Get(_context, index).ToLocal(&value)) {
+            return false;
+          }
+          if (doubles && value->IsNumber()) {
+            _writer.WriteDouble(value.As<Number>()->Value());
+            return true;
+          }
+        } else if (!items->Get(_context, index).ToLocal(&item)) {
+          return false;
+        } else if (kind == FrameKind::kMap || kind == FrameKind::kSet) {
+          value = item;
+        } else {
+          if (
+            !(kind == FrameKind::kHost ? WriteHostKey(item)
+                                       : WriteKey(item, offset)) ||
+            !object->Get(_context, item).ToLocal(&value)) {
+            return false;
+          }
+          if (kind == FrameKind::kHost) {
+            if (value->StrictEquals(object)) {
+              _writer.WriteSelf();
+              return true;
+            }
+            if (value->IsSymbol() || value->IsSymbolObject()) {
+              return WriteSymbol(value);
+            }
+          }
+        }
+        if (!value->IsObject()) {
+          return WritePrimitive(value);
+        }
+        value = scope.Escape(value);
+      }
+      return WriteObject(value.As<Object>());
+    }
+
+    bool WriteValue(Local<Value> value) {
+      return value->IsObject() ? WriteObject(value.As<Object>())
+                               : WritePrimitive(value);
+    }
+
+    bool WriteKey(Local<Value> key, uint32_t offset = 0) {
+      if (key->IsNumber()) {
+        _writer.WriteNumber(key.As<Number>()->Value() - offset);
+      } else {
+        WriteString(key.As<String>());
+      }
+      return true;
+    }
+
+    bool WriteHostKey(Local<Value> key) {
+      if (key->IsSymbol() || key->IsSymbolObject()) {
+        return WriteSymbol(key);
+      }
+      if (!key->IsString() && !key->IsNumber()) {
+        _isolate->ThrowError(
+          "Failed to serialize a non-serializable value: Key");
+        return false;
+      }
+      uint32_t entry;
+      if (
+        key->IsString() &&
+        delegate::FindEntry(_context, _dictionary, key, &entry)) {
+        _writer.WriteEntry(entry);
+        return true;
+      }
+      return WriteKey(key);
+    }
+
+    // Write a global symbol key or value of a host object by description.
+    bool WriteSymbol(Local<Value> value) {
+      auto symbol = value->IsSymbolObject()
+        ? value.As<SymbolObject>()->ValueOf()
+        : value.As<Symbol>();
+      Local<Value> description = symbol->Description(_isolate);
+      if (description.IsEmpty() || description->IsNullOrUndefined()) {
+        _isolate->ThrowError(
+          "Failed to serialize a non-serializable value: Symbol");
+        return false;
+      }
+      _writer.WriteSymbol(ViewString(description.As<String>()));
+      return true;
+    }
+
+    /**
+     * View the characters of `string` as V8 writes them, for the values
+     * whose strings are not written through `WriteString`. The view is
+     * valid until the next call.
+     */
+    StringView ViewString(Local<String> string) {
+      int length = string->Length();
+      StringView view;
+      if (
+        string->IsOneByte() ||
+        (_canonical && string->ContainsOnlyOneByte())) {
+        _chars.resize((length + 1) / 2);
+        string->WriteOneByte(
+          _isolate,
+          reinterpret_cast<uint8_t*>(_chars.data()),
+          0,
+          length,
+          String::NO_NULL_TERMINATION);
+        view.size = length;
+        view.encoding = StringEncoding::kLatin1;
+      } else {
+        _chars.resize(length);
+        string->Write(
+          _isolate, _chars.data(), 0, length, String::NO_NULL_TERMINATION);
+        view.size = length * 2;
+        view.encoding = StringEncoding::kUtf16;
+      }
+      view.data = reinterpret_cast<const uint8_t*>(_chars.data());
+      return view;
+    }
+
+    void WriteString(Local<String> string) {
+      int length = string->Length();
+      // V8 may keep strings of one-byte characters in two-byte form.
+      if (
+        string->IsOneByte() ||
+        (_canonical && string->ContainsOnlyOneByte())) {
+        uint8_t* out = _writer.ReserveOneByteString(length);
+        if (out && length) {
+          string->WriteOneByte(
+            _isolate, out, 0, length, String::NO_NULL_TERMINATION);
+        }
+      } else {
+        uint8_t* out = _writer.ReserveTwoByteString(length);
+        if (out && length) {
+          string->Write(
+            _isolate,
+            reinterpret_cast<uint16_t*>(out),
+            0,
+            length,
+            String::NO_NULL_TERMINATION);
+        }
+      }
+    }
+
+    void WriteBigInt(Local<BigInt> bigint, bool object) {
+      int words = bigint->WordCount();
+      int sign = 0;
+      _words.resize(words);
+      bigint->ToWordsArray(&sign, &words, _words.data());
+      auto digits = reinterpret_cast<const uint8_t*>(_words.data());
+      if (object) {
+        _writer.WriteBigIntObject(sign, digits, words * sizeof(uint64_t));
+      } else {
+        _writer.WriteBigInt(sign, digits, words * sizeof(uint64_t));
+      }
+    }
+
+    bool WritePrimitive(Local<Value> value) {
+      if (value->IsUndefined()) {
+        _writer.WriteUndefined();
+      } else if (value->IsNull()) {
+        _writer.WriteNull();
+      } else if (value->IsBoolean()) {
+        _writer.WriteBoolean(value->IsTrue());
+      } else if (value->IsInt32()) {
+        _writer.WriteInt32(value.As<Int32>()->Value());
+      } else if (value->IsNumber()) {
+        _writer.WriteDouble(value.As<Number>()->Value());
+      } else if (value->IsBigInt()) {
+        WriteBigInt(value.As<BigInt>(), false);
+      } else if (value->IsString()) {
+        WriteString(value.As<String>());
+      } else {
+        ThrowCloneError(value); // Symbols can only appear in host objects.
+        return false;
+      }
+      return true;
+    }
+
+    bool WriteObject(Local<Object> object) {
+      uint32_t id;
+      if (_ids.Find(object, &id)) {
+        _writer.WriteReference(id);
+        return true;
+      }
+      if (object->IsArrayBufferView()) {
+        return WriteArrayBufferView(object.As<ArrayBufferView>());
+      }
+      if (
+        object->IsFunction() || object->IsProxy() ||
+        object->IsSharedArrayBuffer() || object->IsSymbolObject() ||
+        object->IsWeakMap() || object->IsWeakSet() || object->IsPromise() ||
+        object->IsGeneratorObject() || object->IsModuleNamespaceObject() ||
+        object->IsMapIterator() || object->IsSetIterator() ||
+        object->IsWasmModuleObject() || object->IsExternal()) {
+        ThrowCloneError(object);
+        return false;
+      }
+      _ids.Insert(object, _writer.nextId());
+      if (object->IsArray()) {
+        return WriteArray(object.As<Array>());
+      }
+      if (object->IsMap()) {
+        Local<Array> entries = object.As<Map>()->AsArray();
+        if (_canonical && !SortItems(&entries, 2)) {
+          return false;
+        }
+        _writer.BeginMap();
+        Push(FrameKind::kMap, object, entries);
+        return true;
+      }
+      if (object->IsSet()) {
+        Local<Array> values = object.As<Set>()->AsArray();
+        if (_canonical && !SortItems(&values)) {
+          return false;
+        }
+        _writer.BeginSet();
+        Push(FrameKind::kSet, object, values);
+        return true;
+      }
+      if (object->IsDate()) {
+        _writer.WriteDate(object.As<Date>()->ValueOf());
+        return true;
+      }
+      if (object->IsRegExp()) {
+        auto regexp = object.As<RegExp>();
+        _writer.WriteRegExp(
+          ViewString(regexp->GetSource()), regexp->GetFlags());
+        return true;
+      }
+      if (object->IsBooleanObject()) {
+        _writer.WriteBooleanObject(object.As<BooleanObject>()->ValueOf());
+        return true;
+      }
+      if (object->IsNumberObject()) {
+        _writer.WriteNumberObject(object.As<NumberObject>()->ValueOf());
+        return true;
+      }
+      if (object->IsBigIntObject()) {
+        WriteBigInt(object.As<BigIntObject>()->ValueOf(), true);
+        return true;
+      }
+      if (object->IsStringObject()) {
+        _writer.WriteStringObject(
+          ViewString(object.As<StringObject>()->ValueOf()));
+        return true;
+      }
+      if (object->IsArrayBuffer()) {
+        return WriteArrayBuffer(object.As<ArrayBuffer>());
+      }
+      return WriteJSObject(object);
+    }
+
+    bool WriteArray(Local<Array> array) {
+      Local<Array> keys;
+      if (!array
+             ->GetPropertyNames(
+               _context,
+               KeyCollectionMode::kOwnOnly,
+               static_cast<PropertyFilter>(
+                 PropertyFilter::ONLY_ENUMERABLE |
+                 PropertyFilter::SKIP_SYMBOLS),
+               IndexFilter::kIncludeIndices,
+               KeyConversionMode::kKeepNumbers)
+             .ToLocal(&keys)) {
+        return false;
+      }
+      // Indices come first and in order, so the array has no holes if the
+      // last element's index is where it would be. V8 also writes holey
+      // arrays without holes as sparse, which cannot be told apart here.
+      uint32_t length = array->Length();
+      bool dense = length == 0;
+      if (length > 0 && keys->Length() >= length) {
+        Local<Value> last;
+        if (!keys->Get(_context, length - 1).ToLocal(&last)) {
+          return false;
+        }
+        dense = last->IsNumber() && last.As<Number>()->Value() == length - 1;
+      }
+      // Only the named properties after the indices need sorting.
+      if (
+        _canonical && keys->Length() > (dense ? length : 0) &&
+        !SortItems(&keys, 1, dense ? length : 0)) {
+        return false;
+      }
+      _writer.BeginArray(length, !dense);
+      Push(
+        dense ? FrameKind::kDenseArray : FrameKind::kSparseArray,
+        array,
+        keys,
+        dense ? length : 0);
+      _stack.back().doubles = dense && HasDoubleElements(array);
+      return true;
+    }
+
+    // V8 keeps arrays of numbers that are not all small integers as doubles,
+    // and writes every element of those as a double. Their elements kind is
+    // not exposed, so this guesses it from the elements (see README).
+    bool HasDoubleElements(Local<Array> array) {
+      struct Scan {
+        bool numbers = true;
+        bool fractions = false;
+      } scan;
+      auto visit = [](uint32_t, Local<Value> element, void* data) {
+        auto scan = static_cast<Scan*>(data);
+        if (!element->IsNumber()) {
+          scan->numbers = false;
+          return Array::CallbackResult::kBreak;
+        }
+        scan->fractions |= !element->IsInt32();
+        return Array::CallbackResult::kContinue;
+      };
+      return array->Iterate(_context, visit, &scan).IsJust() &&
+        scan.numbers && scan.fractions;
+    }
+
+    bool WriteArrayBuffer(Local<ArrayBuffer> buffer) {
+      if (buffer->WasDetached()) {
+        ThrowCloneError(buffer);
+        return false;
+      }
+      if (buffer->IsResizableByUserJavaScript()) {
+        _writer.WriteResizableArrayBuffer(
+          buffer->Data(), buffer->ByteLength(), buffer->MaxByteLength());
+      } else {
+        _writer.WriteArrayBuffer(buffer->Data(), buffer->ByteLength());
+      }
+      return true;
+    }
+
+    bool WriteArrayBufferView(Local<ArrayBufferView> view) {
+      ArrayBufferViewTag tag;
+      if (view->IsUint8Array()) {
+        tag = ArrayBufferViewTag::kUint8Array;
+      } else if (view->IsInt8Array()) {
+        tag = ArrayBufferViewTag::kInt8Array;
+      } else if (view->IsUint8ClampedArray()) {
+        tag = ArrayBufferViewTag::kUint8ClampedArray;
+      } else if (view->IsInt16Array()) {
+        tag = ArrayBufferViewTag::kInt16Array;
+      } else if (view->IsUint16Array()) {
+        tag = ArrayBufferViewTag::kUint16Array;
+      } else if (view->IsInt32Array()) {
+        tag = ArrayBufferViewTag::kInt32Array;
+      } else if (view->IsUint32Array()) {
+        tag = ArrayBufferViewTag::kUint32Array;
+      } else if (view->IsFloat32Array()) {
+        tag = ArrayBufferViewTag::kFloat32Array;
+      } else if (view->IsFloat64Array()) {
+        tag = ArrayBufferViewTag::kFloat64Array;
+      } else if (view->IsBigInt64Array()) {
+        tag = ArrayBufferViewTag::kBigInt64Array;
+      } else if (view->IsBigUint64Array()) {
+        tag = ArrayBufferViewTag::kBigUint64Array;
+      } else if (view->IsDataView()) {
+        tag = ArrayBufferViewTag::kDataView;
+      } else {
+        ThrowCloneError(view);
+        return false;
+      }
+      // The buffer is written first, then the view over it.
+      auto buffer = view->Buffer();
+      uint32_t id;
+      if (buffer->IsSharedArrayBuffer()) {
+        ThrowCloneError(buffer);
+        return false;
+      }
+      if (_ids.Find(buffer, &id)) {
+        _writer.WriteReference(id);
+      } else {
+        _ids.Insert(buffer, _writer.nextId());
+        if (!WriteArrayBuffer(buffer)) {
+          return false;
+        }
+      }
+      _ids.Insert(view, _writer.nextId());
+      // Whether a view tracks the length of its buffer is not exposed, so
+      // views over resizable buffers are written with a fixed length.
+      _writer.WriteArrayBufferView(
+        tag,
+        static_cast<uint32_t>(view->ByteOffset()),
+        static_cast<uint32_t>(view->ByteLength()),
+        buffer->IsResizableByUserJavaScript()
+          ? uint32_t{serialism::wire::kIsBackedByRab}
+          : 0u);
+      return true;
+    }
+
+    bool WriteJSObject(Local<Object> object) {
+      // Plain objects are written with their enumerable string keys, which
+      // also spare the classifier listing them.
+      Local<Array> visited;
+      if (
+        _classifier.Classify(_isolate, object) ==
+          delegate::ClassKind::kPlain &&
+        !object
+           ->GetPropertyNames(
+             _context,
+             KeyCollectionMode::kOwnOnly,
+             static_cast<PropertyFilter>(
+               PropertyFilter::ONLY_ENUMERABLE | PropertyFilter::SKIP_SYMBOLS),
+             IndexFilter::kIncludeIndices,
+             KeyConversionMode::kKeepNumbers)
+           .ToLocal(&visited)) {
+        return false;
+      }
+      bool isHost;
+      {
+        // IsHostObject reports unregistered classes by throwing.
+        HandleScope scope(_isolate);
+        v8::TryCatch tryCatch(_isolate);
+        isHost = _classifier.IsHostObject(_isolate, object, visited)
+                   .FromMaybe(false);
+        if (tryCatch.HasCaught()) {
+          tryCatch.ReThrow();
+          return false;
+        }
+      }
+      if (isHost) {
+        Local<Value> className;
+        if (!_classifier.GetHostClassName(_isolate, object)
+               .ToLocal(&className)) {
+          return false;
+        }
+        Local<Array> keys;
+        if (!_classifier
+               .GetHostPropertyNames(
+                 _context,
+                 object,
+                 _classifier.GetClassFields(_context, className))
+               .ToLocal(&keys)) {
+          return false;
+        }
+        if (_canonical && !SortItems(&keys)) {
+          return false;
+        }
+        if (className->IsString()) {
+          uint32_t entry;
+          bool shared =
+            delegate::FindEntry(_context, _dictionary, className, &entry);
+          if (shared && !_countClasses) {
+            _writer.BeginHostObject(entry, keys->Length());
+          } else {
+            Nan::Utf8String name(className);
+            std::string_view view(*name, name.length());
+            if (_countClasses) {
+              Attribute();
+              _owners.push_back(&_classSizes[std::string(view)]);
+            }
+            if (shared) {
+              _writer.BeginHostObject(entry, keys->Length());
+            } else {
+              _writer.BeginHostObject(HostClass::kNamed, view, keys->Length());
+            }
+          }
+          Push(FrameKind::kHost, object, keys);
+          _stack.back().counted = _countClasses;
+          return true;
+        }
+        _writer.BeginHostObject(
+          className->IsNull() ? HostClass::kNullPrototype : HostClass::kPlain,
+          std::string_view(),
+          keys->Length());
+        Push(FrameKind::kHost, object, keys);
+        return true;
+      }
+      if (_canonical && !SortItems(&visited)) {
+        return false;
+      }
+      _writer.BeginObject();
+      Push(FrameKind::kObject, object, visited);
+      return true;
+    }
+  };
+
+  /**
+   * Deserializes a payload token by token with `format::Reader`, keeping the
+   * containers being filled on an explicit stack.
+   *
+   * Unlike `ValueDeserializer`, host objects are given their id before their
+   * properties are read, so they may contain references to themselves from
+   * any depth.
+   */
+  class Decoder {
+      public:
+    Decoder(Isolate* isolate, Local<Map> classes):
+      _isolate(isolate),
+      _context(isolate->GetCurrentContext()),
+      _registry(classes) {}
+
+    /**
+     * Resolve the dictionary entries that class names and keys refer to, if
+     * the payload was written with a shared dictionary.
+     */
+    void UseDictionary(Local<Array> entries) {
+      _registry.UseDictionary(entries);
+    }
+
+    /**
+     * Read the value in a payload. Returns an empty handle with an exception
+     * pending if the payload is malformed or refers to unknown classes.
+     */
+    MaybeLocal<Value> Decode(const uint8_t* data, size_t size) {
+      serialism::format::Reader reader(data, size);
+      if (!reader.ReadHeader()) {
+        _isolate->ThrowError("Invalid data");
+        return MaybeLocal<Value>();
+      }
+      Token token;
+      while (true) {
+        if (!reader.Next(&token)) {
+          ThrowInvalid(reader.error());
+          return MaybeLocal<Value>();
+        }
+        if (token.type == TokenType::kEnd) {
+          break;
+        }
+        // Every element takes at least a byte, so a dense array cannot be
+        // longer than the rest of the payload.
+        if (
+          token.type == TokenType::kBeginArray && !token.sparse &&
+          token.length > size - reader.position()) {
+          ThrowInvalid("Array length exceeds payload");
+          return MaybeLocal<Value>();
+        }
+        if (!Accept(token, reader.viewFollows())) {
+          return MaybeLocal<Value>();
+        }
+      }
+      return _root;
+    }
+
+    /**
+     * Like `Decode`, but update the objects of an existing graph rooted at
+     * `target` in place where they match the payload, instead of allocating
+     * new ones. Objects match if they are plain objects, arrays, maps, sets
+     * or instances of the same registered class as the value at the same
+     * position in the payload. Reused objects lose the properties and
+     * entries the payload does not have.
+     */
+    MaybeLocal<Value> DecodeInto(
+      const uint8_t* data, size_t size, Local<Value> target) {
+      _reuse = true;
+      _target = target;
+      _objectPrototype = Object::New(_isolate)->GetPrototype();
+      // Listing keys from JavaScript reuses V8's enum cache, while the API
+      // builds a new key list for every object.
+      Local<Script> script;
+      Local<Value> findStale, root;
+      if (
+        !Script::Compile(
+           _context,
+           Nan::New("(function (batch) {\n"
+                    "  const stale = [];\n"
+                    "  for (let i = 0; i < batch.length; i += 2) {\n"
+                    "    const count = Reflect.ownKeys(batch[i]).length;\n"
+                    "    if (count !== batch[i + 1]) stale.push(i / 2);\n"
+                    "  }\n"
+                    "  return stale;\n"
+                    "})")
+             .ToLocalChecked())
+           .ToLocal(&script) ||
+        !script->Run(_context).ToLocal(&findStale)) {
+        return MaybeLocal<Value>();
+      }
+      _findStale = findStale.As<Function>();
+      if (!Decode(data, size).ToLocal(&root) || !RemoveStaleBatch()) {
+        return MaybeLocal<Value>();
+      }
+      return root;
+    }
+
+      private:
+    enum class FrameKind : uint8_t {
+      kObject,
+      kDenseArray,
+      kSparseArray,
+      kHost,
+      kMap,
+      kSet,
+      kError,
+    };
+
+    struct Frame {
+      FrameKind kind;
+      Local<Object> object;
+      Local<Value> key;   // Pending key
+      bool hasKey;
+      uint32_t length;    // Dense array length
+      uint32_t index;     // Next dense array element
+      uint32_t count;     // Properties, or map and set items, read so far
+      bool reused;        // The object was taken from the target graph
+      size_t written;     // Where the keys it was given start in `_written`
+    };
+
+    Isolate* _isolate;
+    Local<Context> _context;
+    delegate::DeserializeDelegate _registry;
+    std::vector<Frame> _stack;
+    std::vector<Local<Value>> _objects; // By id
+    // Values are created in per-value handle scopes, so cached prototypes
+    // are held by persistent handles.
+    std::unordered_map<std::string, Global<Value>> _prototypes;
+    std::vector<Global<Value>> _entryPrototypes; // By dictionary entry
+    // Property names by their encoded bytes, which outlive the decoder
+    std::unordered_map<std::string_view, Local<String>> _keys;
+    Local<ArrayBuffer> _viewBuffer; // Buffer of the view that follows
+    Local<Value> _root;
+    std::vector<uint16_t> _chars;
+    std::vector<uint64_t> _words;
+    // State for `DecodeInto`
+    bool _reuse = false;
+    Local<Value> _target;
+    Local<Value> _objectPrototype;
+    Local<Function> _findStale;
+    IdentityMap _reused;
+    std::vector<Local<Value>> _written; // Keys given to reused containers
+
+    // A reused object whose stale properties are yet to be removed, with
+    // the keys it was given in `_batchKeys`.
+    struct Stale {
+      Local<Object> object;
+      bool host;
+      size_t start; // Where its keys start in `_batchKeys`
+      size_t count;
+    };
+
+    static constexpr size_t kStaleBatchSize = 1024;
+    std::vector<Stale> _batch;
+    std::vector<Local<Value>> _batchKeys;
+
+    bool ThrowInvalid(const char* reason) {
+      _isolate->ThrowError(
+        String::Concat(
+          _isolate,
+          Nan::New("Invalid data: ").ToLocalChecked(),
+          Nan::New(reason).ToLocalChecked()));
+      return false;
+    }
+
+    void Remember(uint32_t id, Local<Value> object) {
+      if (_objects.size() <= id) {
+        _objects.resize(id + 1);
+      }
+      _objects[id] = object;
+    }
+
+    // Whether the next value delivered is a key or the root, which must
+    // outlive the step that created it.
+    bool ExpectsKey() const {
+      if (_stack.empty()) {
+        return true;
+      }
+      const Frame& frame = _stack.back();
+      switch (frame.kind) {
+        case FrameKind::kDenseArray:
+          return frame.index >= frame.length && !frame.hasKey;
+        case FrameKind::kSet:
+        case FrameKind::kError: return false;
+        default: return !frame.hasKey;
+      }
+    }
+
+    bool Accept(const Token& token, bool viewFollows) {
+      switch (token.type) {
+        case TokenType::kEndObject:
+        case TokenType::kEndArray:
+        case TokenType::kEndMap:
+        case TokenType::kEndSet:
+        case TokenType::kEndHostObject:
+        case TokenType::kEndError: return End(token);
+        case TokenType::kHole:
+          {
+            Frame& frame = _stack.back(); // Holes only occur in arrays.
+            uint32_t index = frame.index++;
+            return !frame.reused ||
+              Updated(frame.object->Delete(_context, index));
+          }
+        case TokenType::kReference:
+          {
+            uint32_t id = token.uint32;
+            if (id >= _objects.size() || _objects[id].IsEmpty()) {
+              return ThrowInvalid("Invalid object reference");
+            }
+            if (viewFollows) {
+              _viewBuffer = _objects[id].As<ArrayBuffer>();
+              return true;
+            }
+            return Deliver(_objects[id]);
+          }
+        case TokenType::kSelf: return Deliver(_stack.back().object);
+        case TokenType::kEntry:
+          {
+            Local<Value> key;
+            return _registry.GetEntry(_isolate, token.uint32, &key) &&
+              Deliver(key);
+          }
+        case TokenType::kString:
+          if (!_stack.empty() && ExpectsKey()) {
+            Local<String> key;
+            return InternKey(token.string, &key) && Deliver(key);
+          }
+          break;
+        default: break;
+      }
+      Local<Value> value;
+      bool reused = false;
+      // Reused objects are remembered in `_reused`, so they are looked up
+      // outside the scope below.
+      if (_reuse && !Reuse(token, &value, &reused)) {
+        return false;
+      }
+      if (!reused) {
+        EscapableHandleScope scope(_isolate);
+        Local<Value> created;
+        if (!Create(token, &created)) {
+          return false;
+        }
+        if (!created->IsObject() && !ExpectsKey()) {
+          return Deliver(created);
+        }
+        value = scope.Escape(created);
+      }
+      if (token.type == TokenType::kArrayBuffer && viewFollows) {
+        Remember(token.id, value);
+        _viewBuffer = value.As<ArrayBuffer>();
+        return true;
+      }
+      if (value->IsObject()) {
+        Remember(token.id, value);
+      }
+      if (!Deliver(value)) {
+        return false;
+      }
+      if (reused && token.type == TokenType::kBeginSet) {
+        value.As<Set>()->Clear();
+      }
+      switch (token.type) {
+        case TokenType::kBeginObject: Push(FrameKind::kObject, value); break;
+        case TokenType::kBeginArray:
+          Push(
+            token.sparse ? FrameKind::kSparseArray : FrameKind::kDenseArray,
+            value,
+            token.sparse ? 0 : token.length);
+          break;
+        case TokenType::kBeginMap: Push(FrameKind::kMap, value); break;
+        case TokenType::kBeginSet: Push(FrameKind::kSet, value); break;
+        case TokenType::kBeginHostObject: Push(FrameKind::kHost, value); break;
+        case TokenType::kBeginError: Push(FrameKind::kError, value); break;
+        default: break;
+      }
+      if (reused) {
+        _stack.back().reused = true;
+      }
+      return true;
+    }
+
+    void Push(FrameKind kind, Local<Value> object, uint32_t length = 0) {
+      _stack.push_back(
+        Frame {
+          kind,
+          object.As<Object>(),
+          Local<Value>(),
+          false,
+          length,
+          0,
+          0,
+          false,
+          _written.size()});
+    }
+
+    // Get the value at the position of the next value in the target graph,
+    // if the container being filled was taken from it.
+    bool Candidate(Local<Value>* out) {
+      if (_stack.empty()) {
+        *out = _target;
+        return true;
+      }
+      const Frame& frame = _stack.back();
+      if (!frame.reused) {
+        return true;
+      }
+      MaybeLocal<Value> current;
+      switch (frame.kind) {
+        case FrameKind::kDenseArray:
+          if (frame.index < frame.length) {
+            current = frame.object->Get(_context, frame.index);
+            break;
+          }
+          [[fallthrough]];
+        case FrameKind::kObject:
+        case FrameKind::kHost:
+          if (!frame.hasKey) {
+            return true; // Keys have no counterpart in the target.
+          }
+          current = frame.object->Get(_context, frame.key);
+          break;
+        case FrameKind::kMap:
+          if (!frame.hasKey) {
+            return true;
+          }
+          current = frame.object.As<Map>()->Get(_context, frame.key);
+          break;
+        default: return true;
+      }
+      return current.ToLocal(out); // Accessors in the target may throw.
+    }
+
+    // Take the object the container begun by `token` replaces in the target
+    // graph, if it is of the same kind and has not been taken already.
+    bool Reuse(const Token& token, Local<Value>* out, bool* reused) {
+      *reused = false;
+      switch (token.type) {
+        case TokenType::kBeginObject:
+        case TokenType::kBeginHostObject:
+        case TokenType::kBeginMap:
+        case TokenType::kBeginSet: break;
+        case TokenType::kBeginArray:
+          if (!token.sparse) {
+            break;
+          }
+          return true;
+        default: return true;
+      }
+      Local<Value> candidate;
+      if (!Candidate(&candidate)) {
+        return false;
+      }
+      if (
+        candidate.IsEmpty() || !candidate->IsObject() || candidate->IsProxy()) {
+        return true;
+      }
+      auto object = candidate.As<Object>();
+      bool matches = false;
+      switch (token.type) {
+        case TokenType::kBeginObject:
+          matches = object->GetPrototype()->StrictEquals(_objectPrototype);
+          break;
+        case TokenType::kBeginArray: matches = object->IsArray(); break;
+        case TokenType::kBeginMap: matches = object->IsMap(); break;
+        case TokenType::kBeginSet: matches = object->IsSet(); break;
+        default:
+          {
+            Local<Value> prototype = _objectPrototype;
+            if (token.hostClass == HostClass::kNullPrototype) {
+              prototype = Nan::Null();
+            } else if (
+              (token.hostClass == HostClass::kNamed ||
+               token.hostClass == HostClass::kEntry) &&
+              !ClassPrototype(token, &prototype)) {
+              return false;
+            }
+            matches = object->GetPrototype()->StrictEquals(prototype);
+          }
+      }
+      uint32_t id;
+      if (!matches || _reused.Find(object, &id)) {
+        return true;
+      }
+      _reused.Insert(object, 0);
+      *out = object;
+      *reused = true;
+      return true;
+    }
+
+    // Delete the properties or entries of a reused container that were not
+    // in the payload, and forget the keys it was given. Objects are checked
+    // in batches, as the check is cheap from JavaScript but not to call.
+    bool RemoveStale(const Frame& frame) {
+      size_t written = _written.size() - frame.written;
+      bool ok = true;
+      switch (frame.kind) {
+        case FrameKind::kMap:
+          ok = RemoveStaleEntries(
+            frame.object.As<Map>(), frame.written, written);
+          break;
+        case FrameKind::kDenseArray:
+          ok = RemoveStaleProperties(
+            frame.object,
+            frame.kind,
+            frame.length,
+            _written.data() + frame.written,
+            written);
+          break;
+        default:
+          {
+            Stale stale {
+              frame.object,
+              frame.kind == FrameKind::kHost,
+              _batchKeys.size(),
+              written};
+            _batchKeys.insert(
+              _batchKeys.end(),
+              _written.begin() + frame.written,
+              _written.end());
+            _batch.push_back(stale);
+            ok = _batch.size() < kStaleBatchSize || RemoveStaleBatch();
+          }
+      }
+      _written.resize(frame.written);
+      return ok;
+    }
+
+    // Objects with as many own properties as they were given keys have no
+    // others. Only the rest are listed.
+    bool RemoveStaleBatch() {
+      if (_batch.empty()) {
+        return true;
+      }
+      HandleScope scope(_isolate);
+      std::vector<Local<Value>> items;
+      items.reserve(_batch.size() * 2);
+      for (const Stale& stale : _batch) {
+        items.push_back(stale.object);
+        items.push_back(
+          Integer::NewFromUnsigned(
+            _isolate, static_cast<uint32_t>(stale.count)));
+      }
+      Local<Value> argv[] = {Array::New(_isolate, items.data(), items.size())};
+      Local<Value> result;
+      if (!_findStale->Call(_context, Nan::Undefined(), 1, argv)
+             .ToLocal(&result)) {
+        return false;
+      }
+      auto indices = result.As<Array>();
+      for (uint32_t i = 0; i < indices->Length(); ++i) {
+        Local<Value> index;
+        if (!indices->Get(_context, i).ToLocal(&index)) {
+          return false;
+        }
+        const Stale& stale = _batch[index.As<Uint32>()->Value()];
+        if (!RemoveStaleProperties(
+              stale.object,
+              stale.host ? FrameKind::kHost : FrameKind::kObject,
+              0,
+              _batchKeys.data() + stale.start,
+              stale.count)) {
+          return false;
+        }
+      }
+      _batch.clear();
+      _batchKeys.clear();
+      return true;
+    }
+
+    // Collect the keys given to a reused container, by property name.
+    bool WrittenKeys(
+      const Local<Value>* written, size_t count, bool names, Local<Set>* out) {
+      Local<Set> keys = Set::New(_isolate);
+      for (size_t i = 0; i < count; ++i) {
+        Local<Value> key = written[i];
+        if (names && key->IsNumber()) {
+          Local<String> name;
+          if (!key->ToString(_context).ToLocal(&name)) {
+            return false;
+          }
+          key = name;
+        }
+        if (keys->Add(_context, key).IsEmpty()) {
+          return false;
+        }
+      }
+      *out = keys;
+      return true;
+    }
+
+    bool RemoveStaleProperties(
+      Local<Object> object,
+      FrameKind kind,
+      uint32_t length,
+      const Local<Value>* written,
+      size_t count) {
+      // Array elements past the payload's length go with the length.
+      bool array = kind == FrameKind::kDenseArray;
+      Local<String> lengthName = Nan::New("length").ToLocalChecked();
+      if (
+        array && object.As<Array>()->Length() != length &&
+        !Updated(
+          object->Set(
+            _context,
+            lengthName,
+            Integer::NewFromUnsigned(_isolate, length)))) {
+        return false;
+      }
+      // A deserialized object only has the properties in the payload, so
+      // symbol keys and non-enumerable properties go as well.
+      Local<Array> names;
+      if (!object
+             ->GetPropertyNames(
+               _context,
+               KeyCollectionMode::kOwnOnly,
+               PropertyFilter::ALL_PROPERTIES,
+               array ? IndexFilter::kSkipIndices : IndexFilter::kIncludeIndices,
+               KeyConversionMode::kConvertToString)
+             .ToLocal(&names)) {
+        return false;
+      }
+      // Every key written is now an own property, so if there are as many
+      // of them, nothing is left over. Arrays also own their length.
+      if (names->Length() == count + array) {
+        return true;
+      }
+      Local<Set> keys;
+      if (!WrittenKeys(written, count, true, &keys)) {
+        return false;
+      }
+      if (array && keys->Add(_context, lengthName).IsEmpty()) {
+        return false;
+      }
+      for (uint32_t i = 0; i < names->Length(); ++i) {
+        Local<Value> name;
+        bool seen;
+        if (
+          !names->Get(_context, i).ToLocal(&name) ||
+          !keys->Has(_context, name).To(&seen) ||
+          (!seen && !Updated(object->Delete(_context, name)))) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool RemoveStaleEntries(Local<Map> map, size_t start, size_t written) {
+      if (map->Size() == written) {
+        return true;
+      }
+      Local<Set> keys;
+      if (!WrittenKeys(_written.data() + start, written, false, &keys)) {
+        return false;
+      }
+      Local<Array> entries = map->AsArray();
+      for (uint32_t i = 0; i < entries->Length(); i += 2) {
+        Local<Value> key;
+        bool seen;
+        if (
+          !entries->Get(_context, i).ToLocal(&key) ||
+          !keys->Has(_context, key).To(&seen) ||
+          (!seen && map->Delete(_context, key).IsNothing())) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool End(const Token& token) {
+      Frame frame = _stack.back();
+      _stack.pop_back();
+      if (frame.reused && frame.kind != FrameKind::kSet) {
+        if (
+          frame.kind == FrameKind::kDenseArray && frame.index != frame.length) {
+          return ThrowInvalid("Array length mismatch");
+        }
+        if (!RemoveStale(frame)) {
+          return false;
+        }
+      }
+      switch (frame.kind) {
+        case FrameKind::kDenseArray:
+          if (frame.index != frame.length) {
+            return ThrowInvalid("Array length mismatch");
+          }
+          [[fallthrough]];
+        case FrameKind::kObject:
+        case FrameKind::kSparseArray:
+        case FrameKind::kMap:
+        case FrameKind::kSet:
+          if (frame.count != token.length) {
+            return ThrowInvalid("Property count mismatch");
+          }
+          return true;
+        default: return true;
+      }
+    }
+
+    // Check the result of changing a property. Properties of reused objects
+    // may be read-only or not configurable, and the objects frozen, which
+    // fails without an exception.
+    bool Updated(Maybe<bool> result) {
+      if (result.IsNothing()) {
+        return false;
+      }
+      if (!result.FromJust()) {
+        Nan::ThrowTypeError("Cannot update a property of the target");
+        return false;
+      }
+      return true;
+    }
+
+    // Add a value to the innermost container, or make it the root.
+    bool Deliver(Local<Value> value) {
+      if (_stack.empty()) {
+        _root = value;
+        return true;
+      }
+      Frame& frame = _stack.back();
+      switch (frame.kind) {
+        case FrameKind::kDenseArray:
+          if (frame.index < frame.length) {
+            return Updated(
+              frame.object->CreateDataProperty(
+                _context, frame.index++, value));
+          }
+          [[fallthrough]];
+        case FrameKind::kObject:
+        case FrameKind::kSparseArray:
+          if (!frame.hasKey) {
+            if (!value->IsString() && !value->IsNumber()) {
+              return ThrowInvalid("Invalid object key");
+            }
+            frame.key = value;
+            frame.hasKey = true;
+            return true;
+          }
+          frame.hasKey = false;
+          ++frame.count;
+          if (frame.reused) {
+            _written.push_back(frame.key);
+          }
+          if (frame.key->IsUint32()) {
+            return Updated(
+              frame.object->CreateDataProperty(
+                _context, frame.key.As<Uint32>()->Value(), value));
+          }
+          if (frame.key->IsNumber()) {
+            Local<String> name;
+            return frame.key->ToString(_context).ToLocal(&name) &&
+              Updated(frame.object->CreateDataProperty(_context, name, value));
+          }
+          return Updated(
+            frame.object->CreateDataProperty(
+              _context, frame.key.As<String>(), value));
+        case FrameKind::kHost:
+          if (!frame.hasKey) {
+            frame.key = value;
+            frame.hasKey = true;
+            return true;
+          }
+          frame.hasKey = false;
+          if (frame.reused) {
+            _written.push_back(frame.key);
+          }
+          return Updated(frame.object->Set(_context, frame.key, value));
+        case FrameKind::kMap:
+          ++frame.count;
+          if (!frame.hasKey) {
+            frame.key = value;
+            frame.hasKey = true;
+            return true;
+          }
+          frame.hasKey = false;
+          // Keys of a reused map are moved to the end, to keep the order of
+          // the payload.
+          if (frame.reused) {
+            _written.push_back(frame.key);
+            if (
+              frame.object.As<Map>()->Delete(_context, frame.key).IsNothing()) {
+              return false;
+            }
+          }
+          return !frame.object.As<Map>()
+                    ->Set(_context, frame.key, value)
+                    .IsEmpty();
+        case FrameKind::kSet:
+          ++frame.count;
+          return !frame.object.As<Set>()->Add(_context, value).IsEmpty();
+        case FrameKind::kError:
+          return frame.object
+            ->DefineOwnProperty(
+              _context, Nan::New("cause").ToLocalChecked(), value, DontEnum)
+            .IsJust();
+      }
+      return false;
+    }
+
+    bool NewString(
+      const StringView& view,
+      Local<String>* out,
+      NewStringType type = NewStringType::kNormal) {
+      MaybeLocal<String> string;
+      switch (view.encoding) {
+        case StringEncoding::kLatin1:
+          string =
+            String::NewFromOneByte(_isolate, view.data, type, view.size);
+          break;
+        case StringEncoding::kUtf8:
+          string = String::NewFromUtf8(
+            _isolate,
+            reinterpret_cast<const char*>(view.data),
+            type,
+            view.size);
+          break;
+        case StringEncoding::kUtf16:
+          {
+            auto chars = reinterpret_cast<const uint16_t*>(view.data);
+            if (reinterpret_cast<uintptr_t>(view.data) % alignof(uint16_t)) {
+              _chars.resize(view.length());
+              std::memcpy(_chars.data(), view.data, view.size);
+              chars = _chars.data();
+            }
+            string =
+              String::NewFromTwoByte(_isolate, chars, type, view.length());
+            break;
+          }
+      }
+      if (!string.ToLocal(out)) {
+        _isolate->ThrowError("Could not create string");
+        return false;
+      }
+      return true;
+    }
+
+    // Property names repeat across objects, so each distinct name is only
+    // created and internalized once per payload.
+    bool InternKey(const StringView& view, Local<String>* out) {
+      std::string_view bytes(
+        reinterpret_cast<const char*>(view.data), view.size);
+      auto cached = _keys.find(bytes);
+      if (cached != _keys.end() && view.encoding == StringEncoding::kLatin1) {
+        *out = cached->second;
+        return true;
+      }
+      if (!NewString(view, out, NewStringType::kInternalized)) {
+        return false;
+      }
+      if (view.encoding == StringEncoding::kLatin1) {
+        _keys.emplace(bytes, *out);
+      }
+      return true;
+    }
+
+    bool NewBigInt(
+      const serialism::format::BigIntView& view, Local<Value>* out) {
+      _words.resize(view.size / sizeof(uint64_t));
+      if (view.size) {
+        std::memcpy(_words.data(), view.digits, view.size);
+      }
+      Local<BigInt> bigint;
+      if (!BigInt::NewFromWords(
+             _context, view.negative, _words.size(), _words.data())
+             .ToLocal(&bigint)) {
+        return false;
+      }
+      *out = bigint;
+      return true;
+    }
+
+    bool Create(const Token& token, Local<Value>* out) {
+      switch (token.type) {
+        case TokenType::kUndefined: *out = Nan::Undefined(); return true;
+        case TokenType::kNull: *out = Nan::Null(); return true;
+        case TokenType::kTrue:
+          *out = Boolean::New(_isolate, true);
+          return true;
+        case TokenType::kFalse:
+          *out = Boolean::New(_isolate, false);
+          return true;
+        case TokenType::kInt32:
+          *out = Integer::New(_isolate, token.int32);
+          return true;
+        case TokenType::kUint32:
+          *out = Integer::NewFromUnsigned(_isolate, token.uint32);
+          return true;
+        case TokenType::kDouble:
+          *out = Number::New(_isolate, token.number);
+          return true;
+        case TokenType::kBigInt: return NewBigInt(token.bigint, out);
+        case TokenType::kString:
+          {
+            Local<String> string;
+            if (!NewString(token.string, &string)) {
+              return false;
+            }
+            *out = string;
+            return true;
+          }
+        case TokenType::kSymbol:
+          {
+            Local<String> description;
+            if (!NewString(token.string, &description)) {
+              return false;
+            }
+            *out = Symbol::For(_isolate, description);
+            return true;
+          }
+        case TokenType::kBeginObject:
+          *out = Object::New(_isolate);
+          return true;
+        case TokenType::kBeginArray:
+          *out = Array::New(_isolate, token.sparse ? 0 : token.length);
+          if (token.sparse) {
+            return out->As<Object>()
+              ->Set(
+                _context,
+                Nan::New("length").ToLocalChecked(),
+                Integer::NewFromUnsigned(_isolate, token.length))
+              .IsJust();
+          }
+          return true;
+        case TokenType::kBeginMap: *out = Map::New(_isolate); return true;
+        case TokenType::kBeginSet: *out = Set::New(_isolate); return true;
+        case TokenType::kDate:
+          return Date::New(_context, token.number).ToLocal(out);
+        case TokenType::kRegExp:
+          {
+            Local<String> pattern;
+            Local<RegExp> regexp;
+            if (
+              !NewString(token.string, &pattern) ||
+              !RegExp::New(
+                 _context, pattern, static_cast<RegExp::Flags>(token.flags))
+                 .ToLocal(&regexp)) {
+              return false;
+            }
+            *out = regexp;
+            return true;
+          }
+        case TokenType::kBooleanObject:
+          *out = BooleanObject::New(_isolate, token.boolean);
+          return true;
+        case TokenType::kNumberObject:
+          *out = NumberObject::New(_isolate, token.number);
+          return true;
+        case TokenType::kBigIntObject:
+          {
+            Local<Value> bigint;
+            Local<Object> object;
+            if (
+              !NewBigInt(token.bigint, &bigint) ||
+              !bigint->ToObject(_context).ToLocal(&object)) {
+              return false;
+            }
+            *out = object;
+            return true;
+          }
+        case TokenType::kStringObject:
+          {
+            Local<String> string;
+            if (!NewString(token.string, &string)) {
+              return false;
+            }
+            *out = StringObject::New(_isolate, string);
+            return true;
+          }
+        case TokenType::kArrayBuffer:
+          {
+            auto buffer = token.resizable
+              ? ArrayBuffer::New(
+                  _isolate,
+                  ArrayBuffer::NewResizableBackingStore(
+                    token.byteLength, token.maxByteLength))
+              : ArrayBuffer::New(_isolate, token.byteLength);
+            if (token.byteLength) {
+              std::memcpy(buffer->Data(), token.bytes, token.byteLength);
+            }
+            *out = buffer;
+            return true;
+          }
+        case TokenType::kArrayBufferView: return CreateView(token, out);
+        case TokenType::kBeginError: return CreateError(token, out);
+        case TokenType::kBeginHostObject: return CreateHostObject(token, out);
+        default: return ThrowInvalid("Unexpected token");
+      }
+    }
+
+    bool CreateView(const Token& token, Local<Value>* out) {
+      if (_viewBuffer.IsEmpty()) {
+        return ThrowInvalid("Array buffer view without a buffer");
+      }
+      auto buffer = _viewBuffer;
+      _viewBuffer = Local<ArrayBuffer>();
+      size_t offset = token.byteOffset;
+      size_t length = token.byteLength;
+      size_t elementSize = 1;
+      switch (token.viewType) {
+        case ArrayBufferViewTag::kInt16Array:
+        case ArrayBufferViewTag::kUint16Array: elementSize = 2; break;
+        case ArrayBufferViewTag::kInt32Array:
+        case ArrayBufferViewTag::kUint32Array:
+        case ArrayBufferViewTag::kFloat32Array: elementSize = 4; break;
+        case ArrayBufferViewTag::kFloat64Array:
+        case ArrayBufferViewTag::kBigInt64Array:
+        case ArrayBufferViewTag::kBigUint64Array: elementSize = 8; break;
+        default: break;
+      }
+      if (
+        token.flags & serialism::wire::kIsLengthTracking &&
+        offset <= buffer->ByteLength()) {
+        // Views cannot be made to track their buffer through the API, so
+        // they cover the whole elements the buffer holds now.
+        length = buffer->ByteLength() - offset;
+        length -= length % elementSize;
+      }
+      if (
+        offset > buffer->ByteLength() ||
+        length > buffer->ByteLength() - offset || offset % elementSize ||
+        length % elementSize) {
+        return ThrowInvalid("Array buffer view out of bounds");
+      }
+      size_t count = length / elementSize;
+      switch (token.viewType) {
+        case ArrayBufferViewTag::kInt8Array:
+          *out = Int8Array::New(buffer, offset, count);
+          return true;
+        case ArrayBufferViewTag::kUint8Array:
+          *out = Uint8Array::New(buffer, offset, count);
+          return true;
+        case ArrayBufferViewTag::kUint8ClampedArray:
+          *out = Uint8ClampedArray::New(buffer, offset, count);
+          return true;
+        case ArrayBufferViewTag::kInt16Array:
+          *out = Int16Array::New(buffer, offset, count);
+          return true;
+        case ArrayBufferViewTag::kUint16Array:
+          *out = Uint16Array::New(buffer, offset, count);
+          return true;
+        case ArrayBufferViewTag::kInt32Array:
+          *out = Int32Array::New(buffer, offset, count);
+          return true;
+        case ArrayBufferViewTag::kUint32Array:
+          *out = Uint32Array::New(buffer, offset, count);
+          return true;
+        case ArrayBufferViewTag::kFloat32Array:
+          *out = Float32Array::New(buffer, offset, count);
+          return true;
+        case ArrayBufferViewTag::kFloat64Array:
+          *out = Float64Array::New(buffer, offset, count);
+          return true;
+        case ArrayBufferViewTag::kBigInt64Array:
+          *out = BigInt64Array::New(buffer, offset, count);
+          return true;
+        case ArrayBufferViewTag::kBigUint64Array:
+          *out = BigUint64Array::New(buffer, offset, count);
+          return true;
+        case ArrayBufferViewTag::kDataView:
+          *out = DataView::New(buffer, offset, length);
+          return true;
+        default: return ThrowInvalid("Unsupported array buffer view type");
+      }
+    }
+
+    bool CreateError(const Token& token, Local<Value>* out) {
+      const char* name = "Error";
+      switch (token.errorPrototype) {
+        case ErrorTag::kEvalErrorPrototype: name = "EvalError"; break;
+        case ErrorTag::kRangeErrorPrototype: name = "RangeError"; break;
+        case ErrorTag::kReferenceErrorPrototype:
+          name = "ReferenceError";
+          break;
+        case ErrorTag::kSyntaxErrorPrototype: name = "SyntaxError"; break;
+        case ErrorTag::kTypeErrorPrototype: name = "TypeError"; break;
+        case ErrorTag::kUriErrorPrototype: name = "URIError"; break;
+        default: break;
+      }
+      Local<Value> constructor;
+      Local<Value> message;
+      Local<Object> error;
+      if (
+        !_context->Global()
+           ->Get(_context, Nan::New(name).ToLocalChecked())
+           .ToLocal(&constructor) ||
+        !constructor->IsFunction()) {
+        return false;
+      }
+      if (token.hasMessage) {
+        Local<String> string;
+        if (!NewString(token.string, &string)) {
+          return false;
+        }
+        message = string;
+      }
+      if (!constructor.As<Function>()
+             ->NewInstance(_context, token.hasMessage ? 1 : 0, &message)
+             .ToLocal(&error)) {
+        return false;
+      }
+      if (token.hasStack) {
+        Local<String> stack;
+        if (
+          !NewString(token.stack, &stack) ||
+          error
+            ->DefineOwnProperty(
+              _context, Nan::New("stack").ToLocalChecked(), stack, DontEnum)
+            .IsNothing()) {
+          return false;
+        }
+      }
+      *out = error;
+      return true;
+    }
+
+    bool CreateHostObject(const Token& token, Local<Value>* out) {
+      auto object = Object::New(_isolate);
+      *out = object;
+      Local<Value> prototype;
+      switch (token.hostClass) {
+        case HostClass::kPlain: return true;
+        case HostClass::kNullPrototype:
+          return object->SetPrototype(_context, Nan::Null()).IsJust();
+        case HostClass::kNamed:
+        case HostClass::kEntry:
+          return ClassPrototype(token, &prototype) &&
+            object->SetPrototype(_context, prototype).IsJust();
+      }
+      return false;
+    }
+
+    // The prototype of the registered class named by a host object token.
+    bool ClassPrototype(const Token& token, Local<Value>* out) {
+      // Registered classes are looked up once per payload.
+      if (token.hostClass == HostClass::kEntry) {
+        uint32_t index = token.uint32;
+        if (
+          index < _entryPrototypes.size() &&
+          !_entryPrototypes[index].IsEmpty()) {
+          *out = _entryPrototypes[index].Get(_isolate);
+          return true;
+        }
+        Local<Value> className;
+        if (
+          !_registry.GetEntry(_isolate, index, &className) ||
+          !FindPrototype(className.As<String>(), out)) {
+          return false;
+        }
+        if (index >= _entryPrototypes.size()) {
+          _entryPrototypes.resize(index + 1);
+        }
+        _entryPrototypes[index].Reset(_isolate, *out);
+        return true;
+      }
+      std::string key(
+        reinterpret_cast<const char*>(token.string.data), token.string.size);
+      key.push_back(static_cast<char>(token.string.encoding));
+      auto cached = _prototypes.find(key);
+      if (cached == _prototypes.end()) {
+        Local<String> className;
+        Local<Value> prototype;
+        if (
+          !NewString(token.string, &className) ||
+          !FindPrototype(className, &prototype)) {
+          return false;
+        }
+        cached =
+          _prototypes.emplace(std::move(key), Global<Value>(_isolate, prototype))
+            .first;
+      }
+      *out = cached->second.Get(_isolate);
+      return true;
+    }
+
+    bool FindPrototype(Local<String> className, Local<Value>* out) {
+      Local<Function> constructor;
+      if (!_registry.GetHostObjectConstructorByName(_isolate, className)
+             .ToLocal(&constructor)) {
+        _isolate->ThrowError(
+          String::Concat(
+            _isolate,
+            Nan::New("No registered class found for: ").ToLocalChecked(),
+            className));
+        return false;
+      }
+      if (
+        !constructor->Get(_context, Nan::New("prototype").ToLocalChecked())
+           .ToLocal(out) ||
+        !(*out)->IsObject()) {
+        *out = constructor->GetPrototype();
+      }
+      return true;
+    }
+  };
+} // namespace traversal
+
+bool checkIsSerialism(Local<Context> context, Local<Object> thisObject) {
+  auto marker =
+    thisObject->GetInternalField(InternalFields::kSerialismInstance);
+  if (
+    marker.IsEmpty() || !marker->IsValue() ||
+    !marker.As<String>()->StrictEquals(
+      Nan::New("SerialismInstance").ToLocalChecked())) {
+    // If the marker is not set or does not match, we throw an error.
+#ifdef SERIALISM_DEBUG
+    std::cerr << "[Serialism] This object is not an instance of Serialism."
+              << std::endl;
+#endif
+    Isolate* isolate = context->GetIsolate();
+    isolate->ThrowError(
+      "This object is not an instance of Serialism. Please create a new "
+      "instance of Serialism before using its methods.");
+    return false;
+  }
+  return true;
+}
+
+uint32_t getOptionFlags(Local<Object> thisObject) {
+  return thisObject->GetInternalField(InternalFields::kOptionFlags)
+    .As<Uint32>()
+    ->Value();
+}
+
+/**
+ * The shared dictionary of a Serialism instance: entries by index, and the
+ * index of each entry.
+ */
+struct SharedDictionary {
+  uint32_t id = 0;
+  Local<Array> entries;
+  Local<Map> indexes;
+};
+
+/**
+ * Get the shared dictionary of the Serialism instance `self`. Entries are
+ * the strings given to the constructor, the names of registered classes and
+ * the fields in their `include` lists, sorted by UTF-16 code units so that
+ * the order of registration does not matter. They are rebuilt after classes
+ * are registered. Returns false if the instance has no dictionary.
+ */
+bool getDictionary(Local<Object> self, SharedDictionary* out) {
+  Local<Value> id =
+    self->GetInternalField(InternalFields::kDictionaryId).As<Value>();
+  if (!id->IsUint32()) {
+    return false;
+  }
+  out->id = id.As<Uint32>()->Value();
+  Local<Value> entries =
+    self->GetInternalField(InternalFields::kDictionaryEntries).As<Value>();
+  if (entries->IsArray()) {
+    out->entries = entries.As<Array>();
+    out->indexes =
+      self->GetInternalField(InternalFields::kDictionaryIndexes).As<Map>();
+    return true;
+  }
+
+  Isolate* isolate = self->GetIsolate();
+  Local<Context> context = isolate->GetCurrentContext();
+  std::vector<std::pair<std::u16string, Local<String>>> strings;
+  auto add = [&](Local<Value> value) {
+    if (!value->IsString()) {
+      return; // Symbols cannot be entries.
+    }
+    auto string = value.As<String>();
+    std::u16string text(string->Length(), u'\0');
+    string->Write(
+      isolate,
+      reinterpret_cast<uint16_t*>(text.data()),
+      0,
+      text.size(),
+      String::NO_NULL_TERMINATION);
+    strings.emplace_back(std::move(text), string);
+  };
+  auto given =
+    self->GetInternalField(InternalFields::kDictionaryStrings).As<Array>();
+  for (uint32_t i = 0; i < given->Length(); ++i) {
+    add(given->Get(context, i).ToLocalChecked());
+  }
+  auto classes = self->GetInternalField(InternalFields::kKnownClasses)
+                   .As<Map>()
+                   ->AsArray();
+  for (uint32_t i = 0; i < classes->Length(); i += 2) {
+    add(classes->Get(context, i).ToLocalChecked());
+  }
+  auto fields = self->GetInternalField(InternalFields::kClassFields)
+                  .As<Map>()
+                  ->AsArray();
+  for (uint32_t i = 1; i < fields->Length(); i += 2) {
+    Local<Value> list = fields->Get(context, i).ToLocalChecked();
+    if (!list->IsArray()) {
+      continue; // Only `include` lists name every field.
+    }
+    for (uint32_t j = 0; j < list.As<Array>()->Length(); ++j) {
+      add(list.As<Array>()->Get(context, j).ToLocalChecked());
+    }
+  }
+  std::sort(strings.begin(), strings.end(), [](auto& a, auto& b) {
+    return a.first < b.first;
+  });
+  strings.erase(
+    std::unique(
+      strings.begin(),
+      strings.end(),
+      [](auto& a, auto& b) {
+        return a.first == b.first;
+      }),
+    strings.end());
+
+  out->entries = Array::New(isolate, strings.size());
+  out->indexes = Map::New(isolate);
+  for (uint32_t i = 0; i < strings.size(); ++i) {
+    out->entries->Set(context, i, strings[i].second).Check();
+    out->indexes
+      ->Set(context, strings[i].second, Integer::NewFromUnsigned(isolate, i))
+      .ToLocalChecked();
+  }
+  self->SetInternalField(InternalFields::kDictionaryEntries, out->entries);
+  self->SetInternalField(InternalFields::kDictionaryIndexes, out->indexes);
+  return true;
+}
+
+/**
+ * Strip the shared dictionary header from a payload, checking that it names
+ * the dictionary of the Serialism instance `self`. `dictionary` is left
+ * empty if the payload has no header.
+ */
+bool readDictionaryHeader(
+  Isolate* isolate,
+  Local<Object> self,
+  const uint8_t** data,
+  size_t* size,
+  SharedDictionary* dictionary) {
+  uint32_t id;
+  size_t header = serialism::format::ReadDictionaryHeader(*data, *size, &id);
+  if (header == 0) {
+    return true;
+  }
+  SharedDictionary own;
+  if (!getDictionary(self, &own) || own.id != id) {
+    std::string message =
+      "Payload requires dictionary " + std::to_string(id);
+    if (!own.entries.IsEmpty()) {
+      message += ", but this instance uses dictionary ";
+      message += std::to_string(own.id);
+    }
+    Nan::ThrowError(message.c_str());
+    return false;
+  }
+  *dictionary = own;
+  *data += header;
+  *size -= header;
+  return true;
+}
+
+/**
+ * Verify the checksum trailer of a buffer and strip it from `size`.
+ */
+bool verifyChecksum(Isolate* isolate, const uint8_t* data, size_t* size) {
+  serialism::checksum::Trailer trailer;
+  uint32_t badBlock = 0;
+  switch (serialism::checksum::Verify(data, *size, &trailer, &badBlock)) {
+    case serialism::checksum::Status::kOk:
+      *size = trailer.payloadSize;
+      return true;
+    case serialism::checksum::Status::kMissingTrailer:
+      isolate->ThrowError("Checksum trailer is missing");
+      return false;
+    case serialism::checksum::Status::kMalformedTrailer:
+      isolate->ThrowError("Checksum trailer is malformed");
+      return false;
+    case serialism::checksum::Status::kMismatch:
+#ifdef SERIALISM_DEBUG
+      std::cerr << "[Serialism] Checksum mismatch in block " << badBlock
+                << std::endl;
+#endif
+      isolate->ThrowError(
+        String::Concat(
+          isolate,
+          Nan::New("Checksum mismatch in block ").ToLocalChecked(),
+          Nan::New<Uint32>(badBlock)
+            ->ToString(isolate->GetCurrentContext())
+            .ToLocalChecked()));
+      return false;
+  }
+  return false;
+}
+
+/**
+ * Read the property names in option `name` of a class's options into `out`,
+ * converting numbers to strings. `out` is left empty if the option is not set.
+ */
+bool getFieldList(
+  Local<Context> context,
+  Local<Object> options,
+  const char* name,
+  std::vector<Local<Value>>* out,
+  bool* set) {
+  Local<Value> option;
+  if (!options->Get(context, Nan::New(name).ToLocalChecked())
+         .ToLocal(&option)) {
+    return false; // The getter threw an exception.
+  }
+  *set = !option->IsUndefined();
+  if (!*set) {
+    return true;
+  }
+  auto invalid = [&] {
+    Nan::ThrowError(
+      (std::string("Option '") + name +
+       "' must be an array of property names")
+        .c_str());
+    return false;
+  };
+  if (!option->IsArray()) {
+    return invalid();
+  }
+  auto list = option.As<Array>();
+  for (uint32_t i = 0; i < list->Length(); ++i) {
+    Local<Value> key;
+    if (!list->Get(context, i).ToLocal(&key)) {
+      return false;
+    }
+    if (key->IsNumber() && !key->ToString(context).ToLocal(&key)) {
+      return false;
+    }
+    if (!key->IsString() && !key->IsSymbol()) {
+      return invalid();
+    }
+    out->push_back(key);
+  }
+  return true;
+}
+
+/**
+ * Parse the options given for a registered class into the list of fields to
+ * include (an array) or exclude (a set), or `undefined` to write them all.
+ */
+MaybeLocal<Value> parseClassFields(
+  Local<Context> context, Local<Object> options) {
+  Isolate* isolate = context->GetIsolate();
+  std::vector<Local<Value>> include, exclude;
+  bool hasInclude, hasExclude;
+  if (
+    !getFieldList(context, options, "include", &include, &hasInclude) ||
+    !getFieldList(context, options, "exclude", &exclude, &hasExclude)) {
+    return MaybeLocal<Value>();
+  }
+  if (hasInclude && hasExclude) {
+    isolate->ThrowError("Options 'include' and 'exclude' cannot be combined");
+    return MaybeLocal<Value>();
+  }
+  if (hasExclude) {
+    Local<Set> excluded = Set::New(isolate);
+    for (auto key : exclude) {
+      if (excluded->Add(context, key).IsEmpty()) {
+        return MaybeLocal<Value>();
+      }
+    }
+    return excluded;
+  }
+  if (hasInclude) {
+    // Each field is written once, in the order it was first listed.
+    Local<Set> seen = Set::New(isolate);
+    std::vector<Local<Value>> included;
+    for (auto key : include) {
+      bool duplicate;
+      if (
+        !seen->Has(context, key).To(&duplicate) ||
+        (!duplicate && seen->Add(context, key).IsEmpty())) {
+        return MaybeLocal<Value>();
+      }
+      if (!duplicate) {
+        included.push_back(key);
+      }
+    }
+    return Array::New(isolate, included.data(), included.size());
+  }
+  return Nan::Undefined();
+}
+
+/**
+ * Parse the `dictionary` option of the constructor into its id and a copy of
+ * its strings.
+ */
+bool parseDictionary(
+  Local<Context> context,
+  Local<Value> option,
+  Local<Value>* id,
+  Local<Array>* strings) {
+  Isolate* isolate = context->GetIsolate();
+  if (!option->IsObject() || option->IsArray()) {
+    isolate->ThrowError("Option 'dictionary' must be an object");
+    return false;
+  }
+  auto dictionary = option.As<Object>();
+  Local<Value> given;
+  if (!dictionary->Get(context, Nan::New("id").ToLocalChecked()).ToLocal(id)) {
+    return false;
+  }
+  if (!(*id)->IsUint32()) {
+    isolate->ThrowError("Dictionary 'id' must be an unsigned 32-bit integer");
+    return false;
+  }
+  if (!dictionary->Get(context, Nan::New("strings").ToLocalChecked())
+         .ToLocal(&given)) {
+    return false;
+  }
+  std::vector<Local<Value>> copied;
+  if (!given->IsUndefined()) {
+    if (!given->IsArray()) {
+      isolate->ThrowError("Dictionary 'strings' must be an array of strings");
+      return false;
+    }
+    auto list = given.As<Array>();
+    for (uint32_t i = 0; i < list->Length(); ++i) {
+      Local<Value> string;
+      if (!list->Get(context, i).ToLocal(&string)) {
+        return false;
+      }
+      if (!string->IsString()) {
+        isolate->ThrowError(
+          "Dictionary 'strings' must be an array of strings");
+        return false;
+      }
+      copied.push_back(string);
+    }
+  }
+  *strings = Array::New(isolate, copied.data(), copied.size());
+  return true;
+}
+
+/**
+ * Register a javascript class for serialization/deserialization. A class may
+ * be followed by an options object listing the fields to `include` or
+ * `exclude` when its instances are serialized.
+ */
+NAN_METHOD(registerClass) {
+  Local<Context> ctx = Nan::GetCurrentContext();
+  Isolate* isolate = ctx->GetIsolate();
+  Local<Context> context = isolate->GetCurrentContext();
+  HandleScope scope(isolate);
+
+  if (!checkIsSerialism(context, info.This())) {
+    return; // If the object is not a Serialism instance, we throw an error.
+  }
+
+  auto count = info.Length();
+
+  Local<Map> classes =
+    info.This()->GetInternalField(InternalFields::kKnownClasses).As<Map>();
+  Local<Map> fields =
+    info.This()->GetInternalField(InternalFields::kClassFields).As<Map>();
+
+  // The shared dictionary, if any, is rebuilt when it is next used.
+  info.This()->SetInternalField(
+    InternalFields::kDictionaryEntries, Nan::Undefined());
+
+  for (int i = 0; i < count; ++i) {
+    if (!info[i]->IsFunction()) {
+      isolate->ThrowError("All arguments must be constructor functions");
+      return;
+    }
+
+    auto arg = info[i];
+
+    if (!arg->IsFunction()) {
+      isolate->ThrowError("Argument must be a class");
+      return;
+    }
+
+    Local<Function> constructor = arg.As<Function>();
+
+    if (!constructor->IsConstructor()) {
+      Nan::ThrowError("Argument must be a class");
+      return;
+    }
+
+    // Register the constructor for serialization.
+
+    auto name = constructor->GetName();
+
+    if (
+      name.IsEmpty() || !name->IsString() || name.As<String>()->Length() == 0) {
+      isolate->ThrowError("Class must have a name");
+      return;
+    }
+
+    if (arg->IsProxy()) {
+      isolate->ThrowError("Cannot register a proxy as a class");
+      return;
+    }
+
+    // Options apply to the class they follow.
+    Local<Value> classFields;
+    bool hasOptions = i + 1 < count && info[i + 1]->IsObject() &&
+      !info[i + 1]->IsFunction();
+    if (
+      hasOptions &&
+      !parseClassFields(context, info[++i].As<Object>())
+         .ToLocal(&classFields)) {
+      return;
+    }
+
+    bool registered = false;
+    if (classes->Has(ctx, name).FromJust()) {
+      if (classes->Get(ctx, name).ToLocalChecked()->StrictEquals(constructor)) {
+        // If the class is already registered, only its options are updated.
+        registered = true;
+      } else { // If two different classes share the same name, throw an error.
+        isolate->ThrowError(
+          String::Concat(
+            isolate,
+            String::Concat(
+              isolate,
+              Nan::New("A different class with the name '").ToLocalChecked(),
+              name.As<String>()),
+            Nan::New("' is already registered.").ToLocalChecked()));
+        return;
+      }
+    }
+
+    if (hasOptions) {
+      if (classFields->IsUndefined()) {
+        fields->Delete(context, name).Check();
+      } else {
+        fields->Set(context, name, classFields).ToLocalChecked();
+      }
+    }
+
+    if (registered) {
+      continue;
+    }
+
+    String::Utf8Value utf8Value(isolate, name);
 
 #ifdef SERIALISM_DEBUG
     std::cout << "Registering class: " << *utf8Value << std::endl;
 #endif
 
-    classes->Set(isolate->GetCurrentContext(), name, constructor)
-      .ToLocalChecked();
+    classes->Set(isolate->GetCurrentContext(), name, constructor)
+      .ToLocalChecked();
+  }
+
+  info.GetReturnValue().Set(info.This());
+}
+
+/**
+ * Apply the options of the Serialism instance `self` to `encoder`.
+ */
+template <typename Sink>
+void configureEncoder(
+  traversal::Encoder<Sink>& encoder, Local<Object> self) {
+  if (getOptionFlags(self) & OptionFlags::fCanonical) {
+    encoder.Canonical();
+  }
+  SharedDictionary dictionary;
+  if (getDictionary(self, &dictionary)) {
+    encoder.UseDictionary(dictionary.id, dictionary.indexes);
+  }
+}
+
+/**
+ * Run `encoder` over `value` with the options of the Serialism instance
+ * `self`.
+ */
+template <typename Sink>
+bool encodeValue(
+  Isolate* isolate,
+  traversal::Encoder<Sink>& encoder,
+  Local<Value> value,
+  Local<Object> self) {
+  configureEncoder(encoder, self);
+  if (encoder.Encode(value)) {
+    return true;
+  }
+  if (!isolate->HasPendingException()) {
+    isolate->ThrowError("Could not serialize value");
+  }
+  return false;
+}
+
+/**
+ * Write `value` with V8's serializer into `output`, behind the header of
+ * `dictionary` if it has entry indexes.
+ */
+bool writeWithV8(
+  Isolate* isolate,
+  delegate::SerializeDelegate& delegate,
+  const SharedDictionary& dictionary,
+  Local<Value> value,
+  std::pair<uint8_t*, size_t>* output) {
+  ValueSerializer serializer(isolate, &delegate);
+
+  delegate.SetSerializer(&serializer);
+
+  if (!dictionary.indexes.IsEmpty()) {
+    // The dictionary header goes ahead of V8's own.
+    uint8_t header[6] = {serialism::wire::kDictionaryHeader};
+    size_t length = 1;
+    uint32_t id = dictionary.id;
+    for (; id >= 0x80; id >>= 7) {
+      header[length++] = static_cast<uint8_t>(id | 0x80);
+    }
+    header[length++] = static_cast<uint8_t>(id);
+    serializer.WriteRawBytes(header, length);
+  }
+
+  serializer.WriteHeader();
+
+  if (!serializer.WriteValue(isolate->GetCurrentContext(), value)
+         .FromMaybe(false)) {
+    if (!isolate->HasPendingException()) {
+      isolate->ThrowError("Could not serialize value");
+    }
+    return false;
+  }
+  *output = serializer.Release();
+  return true;
+}
+
+/**
+ * Wrap serialized data allocated with `malloc` in a Buffer that owns it,
+ * adding a checksum trailer if `flags` ask for one.
+ */
+MaybeLocal<Object> newPayloadBuffer(
+  Isolate* isolate, uint32_t flags, std::pair<uint8_t*, size_t> output) {
+  auto [data, size] = output;
+  if (flags & OptionFlags::fChecksum) {
+    size_t total = size + serialism::checksum::TrailerSize(size);
+    auto grown = (uint8_t*) realloc(data, total);
+    if (!grown) {
+      free(data);
+      isolate->ThrowError("Could not allocate checksum trailer");
+      return MaybeLocal<Object>();
+    }
+    serialism::checksum::WriteTrailer(grown, size);
+    data = grown;
+    size = total;
+  }
+  auto buffer = Nan::NewBuffer(
+    (char*) data,
+    size,
+    [](char* data, void* hint) {
+      free(data);
+    },
+    nullptr);
+  if (buffer.IsEmpty()) {
+#ifdef SERIALISM_DEBUG
+    std::cerr << "Error creating buffer from serialized data." << std::endl;
+#endif
+    isolate->ThrowError("Could not create buffer from serialized data");
+  }
+  return buffer;
+}
+
+/**
+ * Serialize `value` into a new Buffer with the options and classes of the
+ * Serialism instance `self`. If `fingerprint` is given, it receives the
+ * XXH64 digest of the payload, computed as it is written.
+ */
+MaybeLocal<Object> serializeValue(
+  Isolate* isolate,
+  Local<Object> self,
+  Local<Value> value,
+  uint64_t* fingerprint = nullptr) {
+  Local<Map> classes =
+    self->GetInternalField(InternalFields::kKnownClasses).As<Map>();
+  Local<Map> fields =
+    self->GetInternalField(InternalFields::kClassFields).As<Map>();
+  uint32_t flags = getOptionFlags(self);
+  std::pair<uint8_t*, size_t> output;
+
+  // V8's serializer cannot sort keys or hash its output as it goes.
+  if (fingerprint) {
+    traversal::Encoder<serialism::format::HashingSink> encoder(
+      isolate, classes, fields);
+    if (!encodeValue(isolate, encoder, value, self)) {
+      return MaybeLocal<Object>();
+    }
+    *fingerprint = encoder.sink().Digest();
+    output = encoder.sink().Release();
+  } else if (flags & (OptionFlags::fIterative | OptionFlags::fCanonical)) {
+    traversal::Encoder<serialism::format::BufferSink> encoder(
+      isolate, classes, fields);
+    if (!encodeValue(isolate, encoder, value, self)) {
+      return MaybeLocal<Object>();
+    }
+    output = encoder.sink().Release();
+  } else {
+    delegate::SerializeDelegate delegate(isolate, classes, fields);
+    SharedDictionary dictionary;
+    if (getDictionary(self, &dictionary)) {
+      delegate.UseDictionary(dictionary.indexes);
+    }
+    bool written;
+    {
+      // Plain objects whose properties are all enumerable are not scanned
+      // for symbol values on the first try, see Encoder::Encode.
+      v8::TryCatch tryCatch(isolate);
+      delegate.Optimistic();
+      written = writeWithV8(isolate, delegate, dictionary, value, &output);
+      if (
+        !written && (!delegate.symbolError() || !tryCatch.CanContinue())) {
+        if (tryCatch.HasCaught()) {
+          tryCatch.ReThrow();
+        }
+        return MaybeLocal<Object>();
+      }
+    }
+    if (!written) {
+      delegate.Precise();
+      if (!writeWithV8(isolate, delegate, dictionary, value, &output)) {
+        return MaybeLocal<Object>();
+      }
+    }
   }
 
-  info.GetReturnValue().Set(info.This());
+  return newPayloadBuffer(isolate, flags, output);
+}
+
+/**
+ * Deserialize the contents of `buffer` with the options and classes of the
+ * Serialism instance `self`. If `target` is given, the objects of the graph
+ * it roots are updated in place where they match the payload.
+ */
+MaybeLocal<Value> deserializeValue(
+  Isolate* isolate,
+  Local<Object> self,
+  Local<Value> buffer,
+  Local<Value> target = Local<Value>()) {
+  if (!node::Buffer::HasInstance(buffer)) {
+    isolate->ThrowError("Argument must be a Buffer instance");
+    return MaybeLocal<Value>();
+  }
+
+  auto data = (uint8_t*) node::Buffer::Data(buffer);
+  size_t size = node::Buffer::Length(buffer);
+
+  if (
+    getOptionFlags(self) & OptionFlags::fChecksum &&
+    !verifyChecksum(isolate, data, &size)) {
+    return MaybeLocal<Value>();
+  }
+
+  const uint8_t* payload = data;
+  size_t payloadSize = size;
+  SharedDictionary dictionary;
+  if (!readDictionaryHeader(
+        isolate, self, &payload, &payloadSize, &dictionary)) {
+    return MaybeLocal<Value>();
+  }
+
+  Local<Map> classes =
+    self->GetInternalField(InternalFields::kKnownClasses).As<Map>();
+
+  if (!target.IsEmpty() || getOptionFlags(self) & OptionFlags::fIterative) {
+    // The reader checks the dictionary header itself.
+    traversal::Decoder decoder(isolate, classes);
+    if (!dictionary.entries.IsEmpty()) {
+      decoder.UseDictionary(dictionary.entries);
+    }
+    return target.IsEmpty() ? decoder.Decode(data, size)
+                            : decoder.DecodeInto(data, size, target);
+  }
+
+  delegate::DeserializeDelegate delegate(classes);
+  ValueDeserializer deserializer(isolate, payload, payloadSize, &delegate);
+
+  delegate.SetDeserializer(&deserializer);
+  if (!dictionary.entries.IsEmpty()) {
+    delegate.UseDictionary(dictionary.entries);
+  }
+
+  if (!deserializer.ReadHeader(isolate->GetCurrentContext()).FromMaybe(false)) {
+    Nan::ThrowError("Invalid data");
+    return MaybeLocal<Value>();
+  }
+
+  auto maybeValue = deserializer.ReadValue(isolate->GetCurrentContext());
+
+  if (maybeValue.IsEmpty() && !isolate->HasPendingException()) {
+    isolate->ThrowError("Could not deserialize value");
+  }
+
+  return maybeValue;
 }
 
 NAN_METHOD(serializeNative) {
@@ -806,36 +4245,48 @@ NAN_METHOD(serializeNative) {
     return;
   }
 
-  Local<Map> classes =
-    info.This()->GetInternalField(InternalFields::kKnownClasses).As<Map>();
-  delegate::SerializeDelegate delegate(isolate, classes);
-  ValueSerializer serializer(isolate, &delegate);
-
-  delegate.SetSerializer(&serializer);
-
-  serializer.WriteHeader();
-
-  if (auto res = serializer.WriteValue(isolate->GetCurrentContext(), value);
-      res.FromMaybe(false)) {
-    auto [data, size] = serializer.Release();
-    auto buffer = Nan::NewBuffer(
-      (char*) data,
-      size,
-      [](char* data, void* hint) {
-        free(data);
-      },
-      nullptr);
-    if (buffer.IsEmpty()) {
-#ifdef SERIALISM_DEBUG
-      std::cerr << "Error creating buffer from serialized data." << std::endl;
-#endif
-      isolate->ThrowError("Could not create buffer from serialized data");
+  bool withFingerprint = false;
+  if (info.Length() > 1 && !info[1]->IsUndefined()) {
+    if (!info[1]->IsObject()) {
+      isolate->ThrowError("Options must be an object");
       return;
     }
-    info.GetReturnValue().Set(buffer.ToLocalChecked());
-  } else if (!isolate->HasPendingException()) {
-    isolate->ThrowError("Could not serialize value");
+    Local<Value> option;
+    if (!info[1]
+           .As<Object>()
+           ->Get(context, Nan::New("fingerprint").ToLocalChecked())
+           .ToLocal(&option)) {
+      return; // The getter threw an exception.
+    }
+    withFingerprint = option->BooleanValue(isolate);
+  }
+
+  Local<Object> buffer;
+  uint64_t fingerprint = 0;
+  if (!serializeValue(
+         isolate, info.This(), value, withFingerprint ? &fingerprint : nullptr)
+         .ToLocal(&buffer)) {
+    return;
+  }
+  if (!withFingerprint) {
+    info.GetReturnValue().Set(buffer);
+    return;
+  }
+  Local<Object> result = Object::New(isolate);
+  if (
+    result
+      ->CreateDataProperty(
+        context, Nan::New("buffer").ToLocalChecked(), buffer)
+      .IsNothing() ||
+    result
+      ->CreateDataProperty(
+        context,
+        Nan::New("fingerprint").ToLocalChecked(),
+        BigInt::NewFromUnsigned(isolate, fingerprint))
+      .IsNothing()) {
+    return;
   }
+  info.GetReturnValue().Set(result);
 }
 
 NAN_METHOD(deserializeNative) {
@@ -847,47 +4298,440 @@ NAN_METHOD(deserializeNative) {
     return; // If the object is not a Serialism instance, we throw an error.
   }
 
-  if (!node::Buffer::HasInstance(info[0])) {
-    isolate->ThrowError("Argument must be a Buffer instance");
+  Local<Value> result;
+  if (deserializeValue(isolate, info.This(), info[0]).ToLocal(&result)) {
+    info.GetReturnValue().Set(result);
+  }
+}
+
+/**
+ * Deserialize a buffer into an existing object graph, reusing its objects
+ * where they match the payload.
+ */
+NAN_METHOD(deserializeIntoNative) {
+  Local<Context> context = Nan::GetCurrentContext();
+  Isolate* isolate = context->GetIsolate();
+  Nan::HandleScope scope;
+
+  if (!checkIsSerialism(context, info.This())) {
+    return; // If the object is not a Serialism instance, we throw an error.
+  }
+
+  Local<Value> result;
+  if (deserializeValue(isolate, info.This(), info[0], info[1])
+        .ToLocal(&result)) {
+    info.GetReturnValue().Set(result);
+  }
+}
+
+/**
+ * Split a top-level array, map or set into a number of payloads that can be
+ * deserialized independently. Items are divided into contiguous runs of
+ * nearly equal length, which are written straight from the container.
+ * Every shard is self-contained, so objects reachable from several shards
+ * are written into each of them.
+ */
+NAN_METHOD(serializeShardedNative) {
+  Local<Context> context = Nan::GetCurrentContext();
+  Isolate* isolate = context->GetIsolate();
+  Nan::HandleScope scope;
+
+  if (!checkIsSerialism(context, info.This())) {
+    return; // If the object is not a Serialism instance, we throw an error.
+  }
+
+  Local<Value> value = info[0];
+  uint32_t length;
+  if (value->IsArray()) {
+    length = value.As<Array>()->Length();
+  } else if (value->IsMap()) {
+    length = static_cast<uint32_t>(value.As<Map>()->Size());
+  } else if (value->IsSet()) {
+    length = static_cast<uint32_t>(value.As<Set>()->Size());
+  } else {
+    isolate->ThrowError("Only arrays, maps and sets can be sharded");
     return;
   }
 
-  delegate::DeserializeDelegate delegate(
-    info.This()->GetInternalField(InternalFields::kKnownClasses).As<Map>());
-  ValueDeserializer deserializer(
+  if (!info[1]->IsUint32() || info[1].As<Uint32>()->Value() == 0) {
+    isolate->ThrowError("Shard count must be a positive integer");
+    return;
+  }
+  // Every shard but that of an empty container holds at least one item.
+  uint32_t count =
+    std::min(info[1].As<Uint32>()->Value(), std::max(length, 1u));
+
+  Local<Object> self = info.This();
+  traversal::Encoder<serialism::format::BufferSink> encoder(
     isolate,
-    (uint8_t*) node::Buffer::Data(info[0]),
-    node::Buffer::Length(info[0]),
-    &delegate);
+    self->GetInternalField(InternalFields::kKnownClasses).As<Map>(),
+    self->GetInternalField(InternalFields::kClassFields).As<Map>());
+  configureEncoder(encoder, self);
+  if (!encoder.BeginRuns(value.As<Object>())) {
+    return;
+  }
+  uint32_t flags = getOptionFlags(self);
+  std::vector<Local<Value>> shards;
+  shards.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    Nan::EscapableHandleScope shardScope;
+    auto begin = static_cast<uint32_t>(uint64_t(length) * i / count);
+    auto end = static_cast<uint32_t>(uint64_t(length) * (i + 1) / count);
+    Local<Object> buffer;
+    if (!encoder.EncodeRun(begin, end)) {
+      if (!isolate->HasPendingException()) {
+        isolate->ThrowError("Could not serialize value");
+      }
+      return;
+    }
+    if (!newPayloadBuffer(isolate, flags, encoder.sink().Release())
+           .ToLocal(&buffer)) {
+      return;
+    }
+    shards.push_back(shardScope.Escape(buffer));
+  }
+  info.GetReturnValue().Set(Array::New(isolate, shards.data(), count));
+}
 
-  delegate.SetDeserializer(&deserializer);
+/**
+ * Collect the elements of a deserialized array shard into `elements`, at
+ * `offset` and on. Only the elements that are present are visited, so holes
+ * cost nothing.
+ */
+bool collectShardElements(
+  Local<Context> context,
+  Local<Array> shard,
+  uint64_t offset,
+  std::vector<std::pair<uint64_t, Local<Value>>>* elements) {
+  std::vector<uint32_t> indices;
+  if (!traversal::ListElements(context, shard, &indices)) {
+    return false;
+  }
+  for (uint32_t index : indices) {
+    Local<Value> element;
+    if (!shard->Get(context, index).ToLocal(&element)) {
+      return false;
+    }
+    elements->emplace_back(offset + index, element);
+  }
+  return true;
+}
 
-  if (!deserializer.ReadHeader(isolate->GetCurrentContext()).FromMaybe(false)) {
-    Nan::ThrowError("Invalid data");
+/**
+ * Append the entries of a deserialized map or set shard to `target`, which
+ * holds the entries of the preceding shards.
+ */
+bool appendShard(
+  Isolate* isolate, Local<Object> target, Local<Object> shard) {
+  Local<Context> context = isolate->GetCurrentContext();
+  if (target->IsMap()) {
+    Local<Array> entries = shard.As<Map>()->AsArray();
+    for (uint32_t i = 0; i < entries->Length(); i += 2) {
+      Local<Value> key, value;
+      if (
+        !entries->Get(context, i).ToLocal(&key) ||
+        !entries->Get(context, i + 1).ToLocal(&value) ||
+        target.As<Map>()->Set(context, key, value).IsEmpty()) {
+        return false;
+      }
+    }
+    return true;
+  }
+  Local<Array> values = shard.As<Set>()->AsArray();
+  for (uint32_t i = 0; i < values->Length(); ++i) {
+    Local<Value> value;
+    if (
+      !values->Get(context, i).ToLocal(&value) ||
+      target.As<Set>()->Add(context, value).IsEmpty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Deserialize the shards produced by `serializeSharded` and merge them, in
+ * order, into a single array, map or set. Arrays are built in one go from
+ * the elements of every shard.
+ */
+NAN_METHOD(deserializeShardsNative) {
+  Local<Context> context = Nan::GetCurrentContext();
+  Isolate* isolate = context->GetIsolate();
+  Nan::HandleScope scope;
+
+  if (!checkIsSerialism(context, info.This())) {
+    return; // If the object is not a Serialism instance, we throw an error.
+  }
+
+  if (!info[0]->IsArray() || info[0].As<Array>()->Length() == 0) {
+    isolate->ThrowError("Argument must be a non-empty array of shards");
     return;
   }
 
-  auto maybeValue = deserializer.ReadValue(isolate->GetCurrentContext());
+  Local<Array> shards = info[0].As<Array>();
+  Local<Object> result;
+  std::vector<std::pair<uint64_t, Local<Value>>> elements;
+  uint64_t length = 0;
+  for (uint32_t i = 0; i < shards->Length(); ++i) {
+    Local<Value> buffer, value;
+    if (
+      !shards->Get(context, i).ToLocal(&buffer) ||
+      !deserializeValue(isolate, info.This(), buffer).ToLocal(&value)) {
+      return;
+    }
+    if (i == 0) {
+      if (!value->IsArray() && !value->IsMap() && !value->IsSet()) {
+        isolate->ThrowError("Shards must contain arrays, maps or sets");
+        return;
+      }
+      result = value.As<Object>();
+    } else if (
+      value->IsArray() != result->IsArray() ||
+      value->IsMap() != result->IsMap() || value->IsSet() != result->IsSet()) {
+      isolate->ThrowError("All shards must contain the same kind of container");
+      return;
+    }
+    if (value->IsArray()) {
+      auto shard = value.As<Array>();
+      if (!collectShardElements(context, shard, length, &elements)) {
+        return;
+      }
+      length += shard->Length();
+    } else if (i > 0 && !appendShard(isolate, result, value.As<Object>())) {
+      return;
+    }
+  }
+  if (!result->IsArray()) {
+    info.GetReturnValue().Set(result);
+    return;
+  }
+  if (length > std::numeric_limits<uint32_t>::max()) {
+    Nan::ThrowRangeError("Merged array is too long");
+    return;
+  }
+  if (elements.size() == length) {
+    std::vector<Local<Value>> values;
+    values.reserve(elements.size());
+    for (auto& [index, element] : elements) {
+      values.push_back(element);
+    }
+    info.GetReturnValue().Set(Array::New(isolate, values.data(), length));
+    return;
+  }
+  // Holes are kept by only defining the elements that are present.
+  Local<Array> array = Array::New(isolate);
+  for (auto& [index, element] : elements) {
+    if (array
+          ->CreateDataProperty(context, static_cast<uint32_t>(index), element)
+          .IsNothing()) {
+      return;
+    }
+  }
+  if (array
+        ->Set(
+          context,
+          Nan::New("length").ToLocalChecked(),
+          Nan::New<Uint32>(static_cast<uint32_t>(length)))
+        .IsNothing()) {
+    return;
+  }
+  info.GetReturnValue().Set(array);
+}
+
+NAN_METHOD(cloneNative) {
+  Local<Context> context = Nan::GetCurrentContext();
+  Isolate* isolate = context->GetIsolate();
+  Nan::EscapableHandleScope scope;
+
+  if (!checkIsSerialism(context, info.This())) {
+    return; // If the object is not a Serialism instance, we throw an error.
+  }
+
+  if (info.Length() < 1) {
+    isolate->ThrowError("Argument is required");
+    return;
+  }
+
+  if (info[0]->IsFunction()) {
+    isolate->ThrowError("Cannot clone functions");
+    return;
+  }
 
-  if (maybeValue.IsEmpty()) {
+  cloning::Cloner cloner(
+    isolate,
+    info.This()->GetInternalField(InternalFields::kKnownClasses).As<Map>(),
+    info.This()->GetInternalField(InternalFields::kClassFields).As<Map>());
+  Local<Value> result;
+  if (!cloner.Clone(info[0]).ToLocal(&result)) {
     if (!isolate->HasPendingException()) {
-      isolate->ThrowError("Could not deserialize value");
+      isolate->ThrowError("Could not clone value");
+    }
+    return;
+  }
+
+  info.GetReturnValue().Set(scope.Escape(result));
+}
+
+/**
+ * Compute the size of `serialize(value)` without producing it. With
+ * `{byClass: true}`, also report the bytes taken by each registered class.
+ */
+NAN_METHOD(estimateSizeNative) {
+  Local<Context> context = Nan::GetCurrentContext();
+  Isolate* isolate = context->GetIsolate();
+  Nan::HandleScope scope;
+
+  if (!checkIsSerialism(context, info.This())) {
+    return; // If the object is not a Serialism instance, we throw an error.
+  }
+
+  if (info.Length() < 1) {
+    isolate->ThrowError("Argument is required");
+    return;
+  }
+
+  if (info[0]->IsFunction()) {
+    isolate->ThrowError("Cannot serialize functions");
+    return;
+  }
+
+  bool byClass = false;
+  if (info.Length() > 1 && !info[1]->IsUndefined()) {
+    if (!info[1]->IsObject()) {
+      isolate->ThrowError("Options must be an object");
+      return;
     }
+    Local<Value> option;
+    if (!info[1]
+           .As<Object>()
+           ->Get(context, Nan::New("byClass").ToLocalChecked())
+           .ToLocal(&option)) {
+      return; // The getter threw an exception.
+    }
+    byClass = option->BooleanValue(isolate);
+  }
+
+  // The explicit-stack encoder writes the same format as ValueSerializer,
+  // so it measures either traversal and never runs out of native stack.
+  traversal::Encoder<serialism::format::CountingSink> encoder(
+    isolate,
+    info.This()->GetInternalField(InternalFields::kKnownClasses).As<Map>(),
+    info.This()->GetInternalField(InternalFields::kClassFields).As<Map>());
+  if (byClass) {
+    encoder.CountClasses();
+  }
+  if (!encodeValue(isolate, encoder, info[0], info.This())) {
+    return;
+  }
+
+  size_t size = encoder.sink().size();
+  if (getOptionFlags(info.This()) & OptionFlags::fChecksum) {
+    size += serialism::checksum::TrailerSize(size);
+  }
+  Local<Number> total = Nan::New<Number>(static_cast<double>(size));
+  if (!byClass) {
+    info.GetReturnValue().Set(total);
     return;
   }
 
-  info.GetReturnValue().Set(maybeValue.ToLocalChecked());
+  Local<Object> classes =
+    Object::New(isolate, Nan::Null(), nullptr, nullptr, 0);
+  for (const auto& [name, bytes] : encoder.classSizes()) {
+    if (
+      classes
+        ->CreateDataProperty(
+          context,
+          Nan::New(name).ToLocalChecked(),
+          Nan::New<Number>(static_cast<double>(bytes)))
+        .IsNothing()) {
+      return;
+    }
+  }
+  Local<Object> result = Object::New(isolate);
+  if (
+    result
+      ->CreateDataProperty(context, Nan::New("total").ToLocalChecked(), total)
+      .IsNothing() ||
+    result
+      ->CreateDataProperty(
+        context, Nan::New("classes").ToLocalChecked(), classes)
+      .IsNothing()) {
+    return;
+  }
+  info.GetReturnValue().Set(result);
 }
 
 NAN_METHOD(constructor) {
   Local<Context> context = Nan::GetCurrentContext();
   Isolate* isolate = context->GetIsolate();
   Nan::HandleScope scope;
+  uint32_t flags = OptionFlags::fNone;
+  Local<Value> dictionaryId = Nan::Undefined();
+  Local<Array> dictionaryStrings = Array::New(isolate);
+  if (info.Length() > 0 && !info[0]->IsUndefined()) {
+    if (!info[0]->IsObject()) {
+      isolate->ThrowError("Options must be an object");
+      return;
+    }
+    auto options = info[0].As<Object>();
+    Local<Value> checksum;
+    if (!options->Get(context, Nan::New("checksum").ToLocalChecked())
+           .ToLocal(&checksum)) {
+      return; // The getter threw an exception.
+    }
+    if (checksum->BooleanValue(isolate)) {
+      flags |= OptionFlags::fChecksum;
+    }
+    Local<Value> canonical;
+    if (!options->Get(context, Nan::New("canonical").ToLocalChecked())
+           .ToLocal(&canonical)) {
+      return;
+    }
+    if (canonical->BooleanValue(isolate)) {
+      flags |= OptionFlags::fCanonical;
+    }
+    Local<Value> traversal;
+    if (!options->Get(context, Nan::New("traversal").ToLocalChecked())
+           .ToLocal(&traversal)) {
+      return;
+    }
+    if (traversal->StrictEquals(Nan::New("iterative").ToLocalChecked())) {
+      flags |= OptionFlags::fIterative;
+    } else if (
+      !traversal->IsUndefined() &&
+      !traversal->StrictEquals(Nan::New("recursive").ToLocalChecked())) {
+      isolate->ThrowError(
+        "Option 'traversal' must be 'recursive' or 'iterative'");
+      return;
+    }
+    Local<Value> dictionary;
+    if (!options->Get(context, Nan::New("dictionary").ToLocalChecked())
+           .ToLocal(&dictionary)) {
+      return;
+    }
+    if (
+      !dictionary->IsUndefined() &&
+      !parseDictionary(
+        context, dictionary, &dictionaryId, &dictionaryStrings)) {
+      return;
+    }
+  }
   Local<Map> classes = Map::New(isolate);
   info.This()->SetInternalField(
     InternalFields::kSerialismInstance,
     Nan::New("SerialismInstance").ToLocalChecked());
   info.This()->SetInternalField(InternalFields::kKnownClasses, classes);
+  info.This()->SetInternalField(
+    InternalFields::kClassFields, Map::New(isolate));
+  info.This()->SetInternalField(
+    InternalFields::kOptionFlags, Nan::New<Uint32>(flags));
+  info.This()->SetInternalField(InternalFields::kDictionaryId, dictionaryId);
+  info.This()->SetInternalField(
+    InternalFields::kDictionaryStrings, dictionaryStrings);
+  info.This()->SetInternalField(
+    InternalFields::kDictionaryEntries, Nan::Undefined());
+  info.This()->SetInternalField(
+    InternalFields::kDictionaryIndexes, Nan::Undefined());
   info.GetReturnValue().Set(info.This());
 }
 
@@ -905,6 +4749,21 @@ NAN_MODULE_INIT(module) {
   objTemplate->Set(
     Nan::New("deserialize").ToLocalChecked(),
     Nan::New<FunctionTemplate>(&deserializeNative));
+  objTemplate->Set(
+    Nan::New("deserializeInto").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(&deserializeIntoNative));
+  objTemplate->Set(
+    Nan::New("serializeSharded").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(&serializeShardedNative));
+  objTemplate->Set(
+    Nan::New("deserializeShards").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(&deserializeShardsNative));
+  objTemplate->Set(
+    Nan::New("clone").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(&cloneNative));
+  objTemplate->Set(
+    Nan::New("estimateSize").ToLocalChecked(),
+    Nan::New<FunctionTemplate>(&estimateSizeNative));
   ctor->InstanceTemplate()->SetInternalFieldCount(
     InternalFields::kInternalFieldCount);
   ctor->SetClassName(Nan::New("Serialism").ToLocalChecked());
@@ -914,4 +4773,4 @@ NAN_MODULE_INIT(module) {
     ctor->GetFunction(ctx).ToLocalChecked());
 }
 
-NODE_MODULE(serialism, module)
+NAN_MODULE_WORKER_ENABLED(serialism, module)
@@ -157,6 +157,18 @@ describe('Basic functionality', function () {
     assert.strictEqual(target[sym], result[sym]);
   });
 
+  it('index keys work alongside symbol keys', function () {
+    const serializer = new Serialism();
+    const sym = Symbol.for('test');
+    const target = { [sym]: 'hello symbols', 0: 'zero', 7: 'seven' };
+    const result = serializer.deserialize<typeof target>(
+      serializer.serialize(target),
+    );
+    assert.strictEqual(result[0], 'zero');
+    assert.strictEqual(result[7], 'seven');
+    assert.strictEqual(result[sym], 'hello symbols');
+  });
+
   it('private symbols do not work but global ones do', function () {
     const serializer = new Serialism();
     const localSym = Symbol();
@@ -170,6 +182,80 @@ describe('Basic functionality', function () {
     expect(() => serializer.serialize(targetGlobal)).to.not.throw();
   });
 
+  it('finds symbol values in nested plain objects', function () {
+    for (const traversal of ['recursive', 'iterative'] as const) {
+      const serializer = new Serialism({ traversal }).register(TestDummy);
+      const target = {
+        rows: [{ id: 1 }, { id: 2, kind: mySymbol }],
+        dummy: new TestDummy('test'),
+      };
+      const data = serializer.serialize(target);
+      assert.deepStrictEqual(serializer.deserialize(data), target);
+      assert.strictEqual(serializer.estimateSize(target), data.length);
+      const { buffer } = serializer.serialize(target, { fingerprint: true });
+      assert.isTrue(buffer.equals(data));
+    }
+  });
+
+  it('keeps non-enumerable symbol values of plain objects', function () {
+    for (const traversal of ['recursive', 'iterative'] as const) {
+      const serializer = new Serialism({ traversal });
+      const target = Object.defineProperty({ a: 1 }, 'hidden', {
+        value: mySymbol,
+      });
+      const result = serializer.deserialize<typeof target>(
+        serializer.serialize({ list: [target] }),
+      ).list[0];
+      assert.strictEqual(result.a, 1);
+      assert.strictEqual((result as { hidden?: symbol }).hidden, mySymbol);
+    }
+  });
+
+  it('retries on symbols that V8 or the encoder could not clone', function () {
+    // Only the message tells the recursive traversal that V8 failed on a
+    // symbol, so these are pinned.
+    const serializer = new Serialism();
+    expect(() => serializer.serialize(Symbol('x'))).to.throw(
+      'Data clone error: Symbol(x) could not be cloned.',
+    );
+    expect(() => serializer.serialize(Object(Symbol('x')))).to.throw(
+      'Data clone error: [object Symbol] could not be cloned.',
+    );
+    for (const traversal of ['recursive', 'iterative'] as const) {
+      const serializer = new Serialism({ traversal });
+      const target = { rows: [{ id: 1, kind: Object(mySymbol) }] };
+      assert.deepStrictEqual(
+        serializer.deserialize(serializer.serialize(target)),
+        { rows: [{ id: 1, kind: mySymbol }] },
+      );
+    }
+  });
+
+  it('runs getters once when nothing needs a retry', function () {
+    for (const traversal of ['recursive', 'iterative'] as const) {
+      let calls = 0;
+      const target = {
+        get value() {
+          ++calls;
+          return () => 1;
+        },
+      };
+      expect(() => new Serialism({ traversal }).serialize(target)).to.throw(
+        'could not be cloned.',
+      );
+      assert.strictEqual(calls, 1);
+    }
+  });
+
+  it('writes an own constructor property as data', function () {
+    const serializer = new Serialism();
+    const target = { constructor: 'not a class', id: 1 };
+    assert.deepStrictEqual(
+      serializer.deserialize(serializer.serialize(target)),
+      target,
+    );
+  });
+
   it('does not serialize unknown classes', function () {
     const serializer = new Serialism();
     const target = new (class A {
@@ -0,0 +1,115 @@
+import { assert, expect } from 'chai';
+import { Serialism } from '..';
+
+class Item {
+  [key: string]: unknown;
+}
+
+function build(order: 'forward' | 'reverse') {
+  const entries: [string, unknown][] = [
+    ['name', 'item'],
+    ['count', 3],
+    ['10', 'ten'],
+    ['2', 'two'],
+  ];
+  if (order === 'reverse') {
+    entries.reverse();
+  }
+  const item = Object.assign(new Item(), Object.fromEntries(entries));
+  const keys: unknown[] = ['b', 2, 'a', null, true, 1.5, NaN];
+  if (order === 'reverse') {
+    keys.reverse();
+  }
+  return {
+    plain: Object.fromEntries(entries),
+    item,
+    map: new Map(keys.map((key) => [key, String(key)])),
+    set: new Set(keys),
+    text: order === 'reverse' ? 'ሴcafé'.slice(1) : 'café',
+  };
+}
+
+describe('Canonical output', function () {
+  it('writes equal values as equal bytes', function () {
+    const serializer = new Serialism({ canonical: true }).register(Item);
+    const forward = serializer.serialize(build('forward'));
+    const reverse = serializer.serialize(build('reverse'));
+    assert.isTrue(forward.equals(reverse));
+    const plain = new Serialism().register(Item);
+    const unsorted = plain.serialize(build('reverse'));
+    assert.isFalse(plain.serialize(build('forward')).equals(unsorted));
+  });
+
+  it('decodes in sorted order', function () {
+    const serializer = new Serialism({ canonical: true }).register(Item);
+    const value = serializer.deserialize<ReturnType<typeof build>>(
+      serializer.serialize(build('reverse')),
+    );
+    assert.deepEqual(Object.keys(value.plain), ['2', '10', 'count', 'name']);
+    assert.instanceOf(value.item, Item);
+    assert.deepEqual(Object.keys(value.item), ['2', '10', 'count', 'name']);
+    assert.deepEqual([...value.set], [null, true, 1.5, 2, NaN, 'a', 'b']);
+    assert.deepEqual([...value.map.keys()], [...value.set]);
+    assert.deepEqual(value, serializer.clone(build('forward')));
+  });
+
+  it('keeps the order of object keys in maps and sets', function () {
+    const serializer = new Serialism({ canonical: true });
+    const first = { id: 1 };
+    const second = { id: 2 };
+    const value = serializer.deserialize<Set<unknown>>(
+      serializer.serialize(new Set([second, 'b', first, 'a'])),
+    );
+    assert.deepEqual([...value], ['a', 'b', second, first]);
+  });
+
+  it('is measured by estimateSize', function () {
+    const serializer = new Serialism({ canonical: true }).register(Item);
+    const value = build('reverse');
+    assert.strictEqual(
+      serializer.estimateSize(value),
+      serializer.serialize(value).length,
+    );
+  });
+});
+
+describe('Fingerprints', function () {
+  it('returns the XXH64 digest of the payload', function () {
+    const serializer = new Serialism();
+    const { buffer, fingerprint } = serializer.serialize('abc', {
+      fingerprint: true,
+    });
+    assert.isTrue(buffer.equals(serializer.serialize('abc')));
+    assert.strictEqual(typeof fingerprint, 'bigint');
+    const other = serializer.serialize('abd', { fingerprint: true });
+    assert.notStrictEqual(other.fingerprint, fingerprint);
+  });
+
+  it('matches for canonical payloads of equal values', function () {
+    const serializer = new Serialism({ canonical: true }).register(Item);
+    const forward = serializer.serialize(build('forward'), {
+      fingerprint: true,
+    });
+    const reverse = serializer.serialize(build('reverse'), {
+      fingerprint: true,
+    });
+    assert.strictEqual(forward.fingerprint, reverse.fingerprint);
+  });
+
+  it('excludes the checksum trailer', function () {
+    const value = { list: Array.from({ length: 5000 }, (_, i) => `item ${i}`) };
+    const plain = new Serialism({ traversal: 'iterative' });
+    const checked = new Serialism({ traversal: 'iterative', checksum: true });
+    const a = plain.serialize(value, { fingerprint: true });
+    const b = checked.serialize(value, { fingerprint: true });
+    assert.strictEqual(a.fingerprint, b.fingerprint);
+    assert.isAbove(b.buffer.length, a.buffer.length);
+    assert.deepEqual(checked.deserialize(b.buffer), value);
+  });
+
+  it('rejects invalid options', function () {
+    expect(() =>
+      new Serialism().serialize(1, 'fingerprint' as unknown as object),
+    ).to.throw('Options must be an object');
+  });
+});
@@ -0,0 +1,46 @@
+import { assert, expect } from 'chai';
+import { Serialism } from '..';
+
+class Payload {
+  constructor(public data: number[]) {}
+}
+
+describe('Checksums', function () {
+  it('round-trips a checksummed buffer', function () {
+    const serializer = new Serialism({ checksum: true }).register(Payload);
+    const target = { payload: new Payload([1, 2, 3]), text: 'hello' };
+    const data = serializer.serialize(target);
+    const plain = new Serialism().register(Payload).serialize(target);
+    assert.isAbove(data.length, plain.length);
+    assert.deepEqual(serializer.deserialize(data), target);
+  });
+
+  it('verifies buffers spanning several blocks', function () {
+    const serializer = new Serialism({ checksum: true });
+    const target = new Uint8Array(300 * 1024).map((_, i) => i & 0xff);
+    const data = serializer.serialize(target);
+    assert.deepEqual(serializer.deserialize(data), target);
+  });
+
+  it('rejects a corrupted buffer', function () {
+    const serializer = new Serialism({ checksum: true });
+    const data = serializer.serialize({ text: 'x'.repeat(70 * 1024) });
+    data[65 * 1024] ^= 1;
+    expect(() => serializer.deserialize(data)).to.throw(
+      'Checksum mismatch in block 1',
+    );
+  });
+
+  it('rejects a buffer without a trailer', function () {
+    const data = new Serialism().serialize({ text: 'hello' });
+    expect(() => new Serialism({ checksum: true }).deserialize(data)).to.throw(
+      'Checksum trailer is missing',
+    );
+  });
+
+  it('rejects non-object options', function () {
+    expect(() => new Serialism(true as never)).to.throw(
+      'Options must be an object',
+    );
+  });
+});
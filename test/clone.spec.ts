@@ -0,0 +1,132 @@
+import { assert, expect } from 'chai';
+import { Serialism } from '..';
+
+class Node {
+  public children: Node[] = [];
+  public parent: Node | null = null;
+  public tag = Symbol.for('node');
+
+  constructor(public name: string) {}
+
+  public add(child: Node): this {
+    child.parent = this;
+    this.children.push(child);
+    return this;
+  }
+}
+
+class Unregistered {
+  constructor(public value: number) {}
+}
+
+describe('Cloning', function () {
+  it('copies registered classes and preserves identity', function () {
+    const serializer = new Serialism().register(Node);
+    const root = new Node('root').add(new Node('a')).add(new Node('b'));
+    const target = { root, first: root.children[0] };
+    const copy = serializer.clone(target);
+    assert.notStrictEqual(copy, target);
+    assert.notStrictEqual(copy.root, root);
+    assert.instanceOf(copy.root, Node);
+    assert.strictEqual(copy.first, copy.root.children[0]);
+    assert.strictEqual(copy.root.children[1].parent, copy.root);
+    assert.strictEqual(copy.root.tag, Symbol.for('node'));
+  });
+
+  it('matches a serialization round trip', function () {
+    const serializer = new Serialism().register(Node);
+    const shared = new Node('shared');
+    const target = {
+      nodes: [shared, new Node('other'), shared],
+      lookup: new Map([['shared', shared]]),
+    };
+    const copy = serializer.clone(target);
+    assert.deepEqual(copy, serializer.deserialize(serializer.serialize(target)));
+    assert.strictEqual(copy.nodes[0], copy.nodes[2]);
+    assert.strictEqual(copy.lookup.get('shared'), copy.nodes[0]);
+  });
+
+  it('copies built-in objects', function () {
+    const buffer = new ArrayBuffer(8);
+    const target = {
+      map: new Map<unknown, unknown>([['key', { value: 1 }]]),
+      set: new Set([1, 'two', null]),
+      date: new Date(0),
+      regexp: /ab+c/gi,
+      bytes: new Uint8Array(buffer, 0, 4).fill(7),
+      words: new Uint16Array(buffer, 4, 2),
+      wrapped: Object(1n),
+      sparse: [1, , 3],
+    };
+    target.map.set(target.set, target.map);
+    const copy = new Serialism().clone(target);
+    assert.deepEqual(copy, target);
+    assert.notStrictEqual(copy.map, target.map);
+    assert.strictEqual(copy.map.get(copy.set), copy.map);
+    assert.strictEqual(copy.bytes.buffer, copy.words.buffer);
+    assert.notStrictEqual(copy.bytes.buffer, buffer);
+    copy.bytes[0] = 1;
+    assert.strictEqual(target.bytes[0], 7);
+    assert.isFalse(1 in copy.sparse);
+  });
+
+  it('copies deeply nested values', function () {
+    let target: { next?: unknown } = {};
+    for (let i = 0; i < 100000; ++i) {
+      target = { next: target };
+    }
+    let depth = 0;
+    for (let copy = new Serialism().clone(target); copy.next; ++depth) {
+      copy = copy.next as typeof copy;
+    }
+    assert.strictEqual(depth, 100000);
+  });
+
+  it('rejects unregistered classes', function () {
+    expect(() => new Serialism().clone({ x: new Unregistered(1) })).to.throw(
+      'No registered class found for Unregistered',
+    );
+  });
+
+  it('rejects values that cannot be serialized', function () {
+    const serializer = new Serialism();
+    expect(() => serializer.clone(() => 1)).to.throw('Cannot clone functions');
+    expect(() => serializer.clone({ fn: () => 1 })).to.throw(
+      '<Function> could not be cloned.',
+    );
+    expect(() => serializer.clone(new SharedArrayBuffer(4))).to.throw(
+      '<SharedArrayBuffer> could not be cloned.',
+    );
+  });
+
+  it('rejects symbols like serialize()', function () {
+    const serializer = new Serialism();
+    for (const value of [
+      { [Symbol()]: 1 },
+      { tag: Symbol() },
+      [Symbol.for('item')],
+      new Set([Symbol('entry')]),
+      Object(Symbol.for('wrapped')),
+    ]) {
+      let expected = '';
+      try {
+        serializer.serialize(value);
+      } catch (error) {
+        expected = (error as Error).message;
+      }
+      assert.notStrictEqual(expected, '');
+      expect(() => serializer.clone(value)).to.throw(expected);
+    }
+  });
+
+  it('copies described symbols as global symbols', function () {
+    const serializer = new Serialism().register(Node);
+    const key = Symbol('key');
+    const target = { [key]: Symbol('value') };
+    const copy = serializer.clone(target);
+    assert.deepEqual(copy, serializer.deserialize(serializer.serialize(target)));
+    const [copiedKey] = Object.getOwnPropertySymbols(copy);
+    assert.strictEqual(copiedKey, Symbol.for('key'));
+    assert.strictEqual(copy[copiedKey as never], Symbol.for('value'));
+  });
+});
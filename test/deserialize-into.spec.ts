@@ -0,0 +1,176 @@
+import { assert, expect } from 'chai';
+import { Serialism } from '..';
+
+class Point {
+  constructor(
+    public x: number,
+    public y: number,
+  ) {}
+}
+
+class Label {
+  constructor(public text: string) {}
+}
+
+describe('Deserializing into existing objects', function () {
+  it('updates matching objects in place', function () {
+    const serializer = new Serialism().register(Point);
+    const state = {
+      points: [new Point(0, 0), new Point(1, 1)],
+      lookup: new Map([['origin', { id: 0 }]]),
+      tags: new Set(['a']),
+    };
+    const [first, second] = state.points;
+    const { points, lookup, tags } = state;
+    const next = {
+      points: [new Point(5, 6), new Point(7, 8)],
+      lookup: new Map([['origin', { id: 1 }]]),
+      tags: new Set(['b', 'c']),
+    };
+    const buffer = serializer.serialize(next);
+    const result = serializer.deserializeInto(buffer, state);
+    assert.strictEqual(result, state);
+    assert.strictEqual(state.points, points);
+    assert.strictEqual(state.points[0], first);
+    assert.strictEqual(state.points[1], second);
+    assert.strictEqual(state.lookup, lookup);
+    assert.strictEqual(state.tags, tags);
+    assert.deepEqual(state, serializer.deserialize(buffer));
+  });
+
+  it('removes properties and entries the payload does not have', function () {
+    const serializer = new Serialism().register(Point);
+    const point = Object.assign(new Point(1, 2), { label: 'old' });
+    const state = {
+      stale: true,
+      point,
+      list: [1, 2, 3],
+      map: new Map([
+        ['k', 1],
+        ['gone', 2],
+      ]),
+    };
+    const buffer = serializer.serialize({
+      point: new Point(3, 4),
+      list: [4],
+      map: new Map([
+        ['new', 3],
+        ['k', 4],
+      ]),
+    });
+    serializer.deserializeInto(buffer, state);
+    assert.notProperty(state, 'stale');
+    assert.strictEqual(state.point, point);
+    assert.notProperty(point, 'label');
+    assert.deepEqual(state.list, [4]);
+    assert.deepEqual([...state.map], [
+      ['new', 3],
+      ['k', 4],
+    ]);
+  });
+
+  it('removes stale properties from large graphs', function () {
+    const serializer = new Serialism();
+    const state = Array.from({ length: 5000 }, (_, id) => ({ id, old: id }));
+    const objects = [...state];
+    const next = Array.from({ length: 5000 }, (_, id) =>
+      id % 2 ? { id: -id } : { id: -id, old: id },
+    );
+    serializer.deserializeInto(serializer.serialize(next), state);
+    assert.deepEqual(state, next);
+    assert.isTrue(state.every((object, i) => object === objects[i]));
+  });
+
+  it('removes symbol and non-enumerable properties', function () {
+    const serializer = new Serialism();
+    const state = { a: 2, [Symbol.for('z')]: 1 };
+    Object.defineProperty(state, 'hidden', { value: 1, configurable: true });
+    const list = Object.defineProperty([1], 'hidden', {
+      value: 1,
+      configurable: true,
+    });
+    serializer.deserializeInto(serializer.serialize({ a: 1 }), state);
+    serializer.deserializeInto(serializer.serialize([2]), list);
+    assert.deepEqual(Reflect.ownKeys(state), ['a']);
+    assert.deepEqual(Reflect.ownKeys(list), ['0', 'length']);
+    assert.deepEqual(serializer.deserialize(serializer.serialize(state)), {
+      a: 1,
+    });
+  });
+
+  it('throws when the target cannot be updated', function () {
+    const serializer = new Serialism();
+    const buffer = serializer.serialize({ a: 1 });
+    expect(() =>
+      serializer.deserializeInto(buffer, Object.freeze({ a: 2 })),
+    ).to.throw(TypeError, 'Cannot update a property of the target');
+    expect(() =>
+      serializer.deserializeInto(buffer, Object.freeze({ a: 1, b: 2 })),
+    ).to.throw(TypeError, 'Cannot update a property of the target');
+    expect(() =>
+      serializer.deserializeInto(serializer.serialize([1]), Object.freeze([2])),
+    ).to.throw(TypeError, 'Cannot update a property of the target');
+  });
+
+  it('reads maps with container keys', function () {
+    const serializer = new Serialism();
+    const keys = [{}, [1], new Map([[1, 2]]), new Set([3])];
+    for (const key of keys) {
+      const buffer = serializer.serialize(new Map([[key, 1]]));
+      const map = serializer.deserialize(buffer) as Map<unknown, number>;
+      const result = serializer.deserializeInto(buffer, map);
+      assert.strictEqual(result, map);
+      assert.strictEqual(map.size, 1);
+      assert.deepEqual([...map.keys()][0], key);
+      assert.strictEqual([...map.values()][0], 1);
+    }
+  });
+
+  it('allocates objects that do not match', function () {
+    const serializer = new Serialism().register(Point, Label);
+    const point = new Point(1, 2);
+    const state = { value: point as Point | Label, list: [1] as unknown };
+    const buffer = serializer.serialize({ value: new Label('x'), list: {} });
+    serializer.deserializeInto(buffer, state);
+    assert.instanceOf(state.value, Label);
+    assert.notStrictEqual(state.value, point);
+    assert.isFalse(Array.isArray(state.list));
+
+    const root = new Point(0, 0);
+    const result = serializer.deserializeInto(serializer.serialize([1]), root);
+    assert.notStrictEqual(result, root);
+    assert.deepEqual(result, [1]);
+    assert.strictEqual(
+      serializer.deserializeInto(serializer.serialize(5), {}),
+      5,
+    );
+  });
+
+  it('reuses each object once', function () {
+    const serializer = new Serialism();
+    const shared = { value: 1 };
+    const state = { a: shared, b: shared };
+    const buffer = serializer.serialize({ a: { value: 2 }, b: { value: 3 } });
+    serializer.deserializeInto(buffer, state);
+    assert.strictEqual(state.a, shared);
+    assert.notStrictEqual(state.b, shared);
+    assert.deepEqual(state, { a: { value: 2 }, b: { value: 3 } });
+  });
+
+  it('preserves references within the payload', function () {
+    const serializer = new Serialism();
+    const state = { a: { value: 1 }, b: { value: 2 } };
+    const shared = { value: 3 };
+    const buffer = serializer.serialize({ a: shared, b: shared });
+    serializer.deserializeInto(buffer, state);
+    assert.strictEqual(state.a, state.b);
+    assert.deepEqual(state.a, shared);
+  });
+
+  it('rejects malformed payloads', function () {
+    const serializer = new Serialism();
+    expect(() =>
+      serializer.deserializeInto(Buffer.from([0xff, 0x0f, 0x6f]), {}),
+    ).to.throw('Invalid data');
+  });
+});
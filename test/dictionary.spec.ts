@@ -0,0 +1,97 @@
+import { assert, expect } from 'chai';
+import { Serialism } from '..';
+
+class Point {
+  constructor(
+    public x: number,
+    public y: number,
+  ) {}
+}
+
+class Call {
+  public id = 1;
+
+  constructor(
+    public method: string,
+    public params: unknown[],
+  ) {}
+}
+
+const dictionary = { id: 300, strings: ['id', 'method', 'params'] };
+
+describe('Shared dictionaries', function () {
+  for (const traversal of ['recursive', 'iterative'] as const) {
+    describe(`with ${traversal} traversal`, function () {
+      it('writes class names and keys as entries', function () {
+        const plain = new Serialism({ traversal }).register(Call, Point);
+        const serializer = new Serialism({ traversal, dictionary }).register(
+          Call,
+          Point,
+          { include: ['x', 'y'] },
+        );
+        const call = new Call('move', [new Point(1, 2), { label: 'a' }]);
+        const buffer = serializer.serialize(call);
+        assert.isBelow(buffer.length, plain.serialize(call).length * 0.75);
+        assert.strictEqual(buffer.indexOf('params'), -1);
+        assert.strictEqual(buffer.indexOf('Point'), -1);
+        assert.strictEqual(serializer.estimateSize(call), buffer.length);
+        const result = serializer.deserialize<Call>(buffer);
+        assert.instanceOf(result, Call);
+        assert.instanceOf(result.params[0], Point);
+        assert.deepEqual(result, call);
+      });
+    });
+  }
+
+  it('does not depend on the order of registration', function () {
+    const sender = new Serialism({ dictionary }).register(Point, Call);
+    const receiver = new Serialism({
+      dictionary: { id: 300, strings: ['params', 'method', 'id', 'id'] },
+      traversal: 'iterative',
+    }).register(Call, Point);
+    const call = new Call('draw', [new Point(3, 4)]);
+    assert.deepEqual(receiver.deserialize(sender.serialize(call)), call);
+    assert.isTrue(sender.serialize(call).equals(receiver.serialize(call)));
+  });
+
+  it('updates graphs in place', function () {
+    const serializer = new Serialism({ dictionary }).register(Call, Point);
+    const state = new Call('old', [new Point(0, 0)]);
+    const point = state.params[0];
+    serializer.deserializeInto(
+      serializer.serialize(new Call('new', [new Point(5, 6)])),
+      state,
+    );
+    assert.strictEqual(state.params[0], point);
+    assert.deepEqual(state, new Call('new', [new Point(5, 6)]));
+  });
+
+  it('rejects payloads written with another dictionary', function () {
+    const serializer = new Serialism({ dictionary }).register(Call);
+    const buffer = serializer.serialize(new Call('ping', []));
+    expect(() => new Serialism().register(Call).deserialize(buffer)).to.throw(
+      'Payload requires dictionary 300',
+    );
+    expect(() =>
+      new Serialism({ dictionary: { id: 301 } })
+        .register(Call)
+        .deserialize(buffer),
+    ).to.throw(
+      'Payload requires dictionary 300, but this instance uses dictionary 301',
+    );
+    const plain = new Serialism().register(Call).serialize(new Call('a', []));
+    assert.deepEqual(serializer.deserialize(plain), new Call('a', []));
+  });
+
+  it('rejects invalid options', function () {
+    expect(() => new Serialism({ dictionary: [] as never })).to.throw(
+      "Option 'dictionary' must be an object",
+    );
+    expect(() => new Serialism({ dictionary: { id: -1 } })).to.throw(
+      "Dictionary 'id' must be an unsigned 32-bit integer",
+    );
+    expect(
+      () => new Serialism({ dictionary: { id: 1, strings: [1] as never } }),
+    ).to.throw("Dictionary 'strings' must be an array of strings");
+  });
+});
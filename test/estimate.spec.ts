@@ -0,0 +1,102 @@
+import { assert, expect } from 'chai';
+import { Serialism } from '..';
+
+class Point {
+  public x: number;
+  public y: number;
+
+  constructor(x: number, y: number) {
+    this.x = x;
+    this.y = y;
+  }
+}
+
+class Shape {
+  public name: string;
+  public points: Point[];
+
+  constructor(name: string, points: Point[]) {
+    this.name = name;
+    this.points = points;
+  }
+}
+
+function sample() {
+  const origin = new Point(0, 0);
+  return {
+    shapes: [
+      new Shape('triangle', [origin, new Point(1, 0), new Point(0, 1)]),
+      new Shape('dot', [origin]),
+    ],
+    text: ['ascii', 'ünïcödé', '😀'.repeat(100)],
+    numbers: [[1, 2, 3], [1, 2.5, -0], [1, 'mixed', 0.5]],
+    bytes: new Float64Array(64),
+    map: new Map<unknown, unknown>([[1, { deep: [null, undefined, true] }]]),
+    big: 2n ** 100n,
+    when: new Date(0),
+  };
+}
+
+describe('Size estimation', function () {
+  it('matches the length of the serialized buffer', function () {
+    for (const options of [{}, { checksum: true }, { traversal: 'iterative' }]) {
+      const serializer = new Serialism(
+        options as { checksum?: boolean },
+      ).register(Point, Shape);
+      const value = sample();
+      assert.strictEqual(
+        serializer.estimateSize(value),
+        serializer.serialize(value).length,
+      );
+      assert.strictEqual(
+        serializer.estimateSize('text'),
+        serializer.serialize('text').length,
+      );
+    }
+  });
+
+  it('breaks sizes down by registered class', function () {
+    const serializer = new Serialism().register(Point, Shape);
+    const value = sample();
+    const estimate = serializer.estimateSize(value, { byClass: true });
+    assert.strictEqual(estimate.total, serializer.serialize(value).length);
+    assert.hasAllKeys(estimate.classes, ['Point', 'Shape']);
+    const points = serializer.estimateSize([new Point(1, 0), new Point(0, 1)], {
+      byClass: true,
+    });
+    // Everything but the header and the enclosing array.
+    assert.strictEqual(
+      points.classes.Point,
+      points.total - serializer.serialize([]).length,
+    );
+    assert.isBelow(
+      estimate.classes.Point + estimate.classes.Shape,
+      estimate.total,
+    );
+  });
+
+  it('measures deeply nested values', function () {
+    let list: { next?: unknown } = {};
+    for (let i = 0; i < 100000; ++i) {
+      list = { next: list };
+    }
+    const serializer = new Serialism({ traversal: 'iterative' });
+    assert.strictEqual(
+      serializer.estimateSize(list),
+      serializer.serialize(list).length,
+    );
+  });
+
+  it('rejects what serialize rejects', function () {
+    const serializer = new Serialism();
+    expect(() => serializer.estimateSize(new Point(1, 2))).to.throw(
+      'No registered class found for Point',
+    );
+    expect(() => serializer.estimateSize(() => 1)).to.throw(
+      'Cannot serialize functions',
+    );
+    expect(() => serializer.estimateSize({}, true as never)).to.throw(
+      'Options must be an object',
+    );
+  });
+});
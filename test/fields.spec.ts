@@ -0,0 +1,105 @@
+import { assert, expect } from 'chai';
+import { Serialism } from '..';
+
+class Shape {
+  public cache = new Map<string, number>([['area', 12]]);
+  public owner: unknown = null;
+  public tag = Symbol.for('shape');
+
+  constructor(
+    public width: number,
+    public height: number,
+  ) {}
+}
+
+class Plain {
+  constructor(public value: number) {}
+}
+
+describe('Class fields', function () {
+  for (const traversal of ['recursive', 'iterative'] as const) {
+    describe(`with ${traversal} traversal`, function () {
+      it('excludes fields', function () {
+        const serializer = new Serialism({ traversal }).register(Shape, {
+          exclude: ['cache', 'owner'],
+        });
+        const shape = new Shape(3, 4);
+        shape.owner = { shape };
+        const result = serializer.deserialize<Shape>(
+          serializer.serialize(shape),
+        );
+        assert.instanceOf(result, Shape);
+        assert.deepEqual(Reflect.ownKeys(result), ['width', 'height', 'tag']);
+        assert.strictEqual(result.width, 3);
+        assert.strictEqual(result.tag, Symbol.for('shape'));
+      });
+
+      it('includes only listed fields', function () {
+        const serializer = new Serialism({ traversal }).register(Shape, {
+          include: ['height', 'width', 'missing', 'width'],
+        });
+        const result = serializer.deserialize<Shape>(
+          serializer.serialize([new Shape(3, 4)]),
+        );
+        assert.deepEqual(Reflect.ownKeys(result[0]), ['height', 'width']);
+      });
+    });
+  }
+
+  it('applies options to the class they follow', function () {
+    const serializer = new Serialism().register(Plain, Shape, {
+      include: ['width'],
+    });
+    const value = { plain: new Plain(1), shape: new Shape(2, 3) };
+    const result = serializer.deserialize<typeof value>(
+      serializer.serialize(value),
+    );
+    assert.deepEqual(result.plain, new Plain(1));
+    assert.deepEqual(Object.keys(result.shape), ['width']);
+  });
+
+  it('is honoured by clone and estimateSize', function () {
+    const serializer = new Serialism().register(Shape, { exclude: ['cache'] });
+    const shape = new Shape(3, 4);
+    const copy = serializer.clone(shape);
+    assert.instanceOf(copy, Shape);
+    assert.notProperty(copy, 'cache');
+    assert.strictEqual(
+      serializer.estimateSize(shape),
+      serializer.serialize(shape).length,
+    );
+  });
+
+  it('replaces options when a class is registered again', function () {
+    const serializer = new Serialism().register(Shape, { exclude: ['cache'] });
+    serializer.register(Shape);
+    let result = serializer.clone(new Shape(1, 2));
+    assert.notProperty(result, 'cache');
+    serializer.register(Shape, {});
+    result = serializer.clone(new Shape(1, 2));
+    assert.property(result, 'cache');
+  });
+
+  it('rejects invalid options', function () {
+    const serializer = new Serialism();
+    expect(() =>
+      serializer.register(Shape, { include: ['width'], exclude: ['cache'] }),
+    ).to.throw("Options 'include' and 'exclude' cannot be combined");
+    expect(() =>
+      serializer.register(Shape, { exclude: 'cache' as unknown as string[] }),
+    ).to.throw("Option 'exclude' must be an array of property names");
+    expect(() =>
+      serializer.register(Shape, { include: [{}] as unknown as string[] }),
+    ).to.throw("Option 'include' must be an array of property names");
+    expect(() => serializer.register({ include: [] })).to.throw(
+      'All arguments must be constructor functions',
+    );
+    expect(() =>
+      serializer.register(Plain, { exclude: [null] as unknown as string[] }),
+    ).to.throw("Option 'exclude' must be an array of property names");
+    assert.throws(
+      () => serializer.serialize(new Plain(1)),
+      'No registered class found for Plain',
+    );
+  });
+});
@@ -0,0 +1,11 @@
+import { parentPort } from 'node:worker_threads';
+import { readShard, Serialism } from '../..';
+
+class Entry {
+  public id = 0;
+}
+
+const entries = readShard<Entry[]>(new Serialism().register(Entry));
+parentPort?.postMessage(
+  entries.map((entry) => (entry instanceof Entry ? entry.id : -1)),
+);
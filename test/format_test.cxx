@@ -0,0 +1,423 @@
+#include <serialism/checksum.h>
+#include <serialism/hash.h>
+#include <serialism/reader.h>
+#include <serialism/writer.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace serialism;
+using format::HostClass;
+using format::TokenType;
+
+static int failures = 0;
+
+#define CHECK(condition)                                      \
+  do {                                                        \
+    if (!(condition)) {                                       \
+      std::fprintf(                                           \
+        stderr,                                               \
+        "%s:%d: CHECK failed: %s\n",                          \
+        __FILE__,                                             \
+        __LINE__,                                             \
+        #condition);                                          \
+      ++failures;                                             \
+    }                                                         \
+  } while (0)
+
+static std::vector<uint8_t> FromHex(const char* hex) {
+  std::vector<uint8_t> out;
+  for (size_t i = 0; hex[i] && hex[i + 1]; i += 2) {
+    std::string byte(hex + i, 2);
+    out.push_back(
+      static_cast<uint8_t>(std::strtoul(byte.c_str(), nullptr, 16)));
+  }
+  return out;
+}
+
+static std::vector<format::Token> ReadAll(
+  const uint8_t* data, size_t size, const char** error = nullptr) {
+  std::vector<format::Token> tokens;
+  format::Reader reader(data, size);
+  format::Token token;
+  if (reader.ReadHeader()) {
+    while (reader.Next(&token)) {
+      tokens.push_back(token);
+      if (token.type == TokenType::kEnd) {
+        break;
+      }
+    }
+  }
+  if (error) {
+    *error = reader.error();
+  }
+  return tokens;
+}
+
+// Output of `serialize([new Point(), new Set([null, true])])` where `Point`
+// is a registered class with a number, a two-byte string, a self-reference,
+// a symbol key and value, a Uint8Array, a BigInt, a Date and a Map.
+static const char* kPointPayload =
+  "ff0f41025c2205506f696e7408002201780049020022056c6162656c000063067000e900"
+  "2d4e00220473656c660200220362756600420209085642000200002203626967005a2000"
+  "00000000000000400000000000000000220164004400000000000014400022016d003b22"
+  "016b41014e000000000000f83f2400013a02012203746167012201762730542c02240002";
+
+static void TestReadsAddonOutput() {
+  auto data = FromHex(kPointPayload);
+  const char* error = nullptr;
+  auto tokens = ReadAll(data.data(), data.size(), &error);
+  CHECK(error == nullptr);
+  std::vector<TokenType> expected = {
+    TokenType::kBeginArray,      TokenType::kBeginHostObject,
+    TokenType::kString,          TokenType::kInt32,
+    TokenType::kString,          TokenType::kString,
+    TokenType::kString,          TokenType::kSelf,
+    TokenType::kString,          TokenType::kArrayBuffer,
+    TokenType::kArrayBufferView, TokenType::kString,
+    TokenType::kBigInt,          TokenType::kString,
+    TokenType::kDate,            TokenType::kString,
+    TokenType::kBeginMap,        TokenType::kString,
+    TokenType::kBeginArray,      TokenType::kDouble,
+    TokenType::kEndArray,        TokenType::kEndMap,
+    TokenType::kSymbol,          TokenType::kSymbol,
+    TokenType::kEndHostObject,   TokenType::kBeginSet,
+    TokenType::kNull,            TokenType::kTrue,
+    TokenType::kEndSet,          TokenType::kEndArray,
+    TokenType::kEnd,
+  };
+  CHECK(tokens.size() == expected.size());
+  for (size_t i = 0; i < tokens.size() && i < expected.size(); ++i) {
+    CHECK(tokens[i].type == expected[i]);
+  }
+  if (tokens.size() != expected.size()) {
+    return;
+  }
+  CHECK(tokens[1].hostClass == HostClass::kNamed);
+  CHECK(tokens[1].string.ToUtf8() == "Point");
+  CHECK(tokens[1].length == 8);
+  CHECK(tokens[5].string.ToUtf8() == "p\xc3\xa9\xe4\xb8\xad");
+  CHECK(tokens[7].id == tokens[1].id);
+  CHECK(tokens[9].byteLength == 2 && tokens[9].bytes[0] == 9);
+  CHECK(tokens[10].viewType == wire::ArrayBufferViewTag::kUint8Array);
+  CHECK(tokens[12].bigint.size == 16 && tokens[12].bigint.digits[8] == 0x40);
+  CHECK(tokens[14].number == 5);
+  CHECK(tokens[19].number == 1.5);
+  CHECK(tokens[22].string.ToUtf8() == "tag");
+  CHECK(tokens[23].string.ToUtf8() == "v");
+}
+
+static void TestRoundTrip() {
+  format::Writer writer;
+  writer.WriteHeader();
+  uint32_t root = writer.BeginObject();
+  writer.WriteString("point");
+  uint32_t point = writer.BeginHostObject(HostClass::kNamed, "Point", 4);
+  writer.WriteString("x");
+  writer.WriteNumber(-3);
+  writer.WriteSymbol("key");
+  writer.WriteString("caf\xc3\xa9");
+  writer.WriteString("self");
+  writer.WriteSelf();
+  writer.WriteInt32(7);
+  writer.WriteSymbol("value");
+  CHECK(writer.EndHostObject());
+  writer.WriteString("again");
+  writer.WriteReference(point);
+  writer.WriteString("list");
+  writer.BeginArray(3);
+  writer.WriteDouble(0.5);
+  writer.WriteHole();
+  writer.WriteReference(root);
+  CHECK(writer.EndArray());
+  writer.WriteString("error");
+  std::string_view message = "boom";
+  writer.BeginError(wire::ErrorTag::kRangeErrorPrototype, &message, nullptr);
+  writer.WriteNull();
+  CHECK(writer.EndError());
+  CHECK(writer.EndObject());
+  CHECK(writer.ok());
+
+  auto [data, size] = writer.sink().Release();
+  const char* error = nullptr;
+  auto tokens = ReadAll(data, size, &error);
+  CHECK(error == nullptr);
+  std::vector<TokenType> expected = {
+    TokenType::kBeginObject,     TokenType::kString,
+    TokenType::kBeginHostObject, TokenType::kString,
+    TokenType::kInt32,           TokenType::kSymbol,
+    TokenType::kString,          TokenType::kString,
+    TokenType::kSelf,            TokenType::kInt32,
+    TokenType::kSymbol,          TokenType::kEndHostObject,
+    TokenType::kString,          TokenType::kReference,
+    TokenType::kString,          TokenType::kBeginArray,
+    TokenType::kDouble,          TokenType::kHole,
+    TokenType::kReference,       TokenType::kEndArray,
+    TokenType::kString,          TokenType::kBeginError,
+    TokenType::kNull,            TokenType::kEndError,
+    TokenType::kEndObject,       TokenType::kEnd,
+  };
+  CHECK(tokens.size() == expected.size());
+  for (size_t i = 0; i < tokens.size() && i < expected.size(); ++i) {
+    CHECK(tokens[i].type == expected[i]);
+  }
+  if (tokens.size() != expected.size()) {
+    std::free(data);
+    return;
+  }
+  CHECK(tokens[2].id == point);
+  CHECK(tokens[4].int32 == -3);
+  CHECK(tokens[6].string.ToUtf8() == "caf\xc3\xa9");
+  CHECK(tokens[13].uint32 == point);
+  CHECK(tokens[18].uint32 == root);
+  CHECK(tokens[19].length == 0 && tokens[19].uint32 == 3);
+  CHECK(tokens[21].errorPrototype == wire::ErrorTag::kRangeErrorPrototype);
+  CHECK(tokens[21].string.ToUtf8() == "boom");
+  CHECK(tokens[24].length == 4);
+  std::free(data);
+}
+
+template <typename Sink>
+static size_t WriteSample(format::BasicWriter<Sink>& writer) {
+  writer.WriteHeader();
+  writer.BeginHostObject(HostClass::kNamed, "Point", 2);
+  writer.WriteString("x");
+  writer.WriteDouble(0.5);
+  writer.WriteSymbol("key");
+  if (uint8_t* chars = writer.ReserveTwoByteString(3)) {
+    std::memcpy(chars, u"abc", 6);
+  }
+  writer.EndHostObject();
+  return writer.sink().size();
+}
+
+static void TestCountingSink() {
+  format::Writer writer;
+  format::BasicWriter<format::CountingSink> counter;
+  size_t size = WriteSample(writer);
+  CHECK(counter.ok());
+  CHECK(WriteSample(counter) == size);
+  CHECK(counter.ReserveOneByteString(4) == nullptr);
+}
+
+static void TestWriterMisuse() {
+  format::Writer writer;
+  writer.WriteHeader();
+  writer.BeginHostObject(HostClass::kPlain, "", 1);
+  writer.BeginObject(); // Objects cannot be keys
+  CHECK(!writer.ok());
+
+  format::Writer unbalanced;
+  unbalanced.WriteHeader();
+  unbalanced.BeginMap();
+  unbalanced.WriteNull();
+  CHECK(!unbalanced.EndMap());
+}
+
+static void TestRejectsMalformedInput() {
+  auto data = FromHex(kPointPayload);
+  const char* error = nullptr;
+  ReadAll(data.data(), data.size() / 2, &error);
+  CHECK(error != nullptr);
+
+  auto bad = FromHex("ff0f5e05");
+  ReadAll(bad.data(), bad.size(), &error);
+  CHECK(error != nullptr);
+
+  auto future = FromHex("ff7f5f");
+  ReadAll(future.data(), future.size(), &error);
+  CHECK(error != nullptr);
+}
+
+static void TestDictionary() {
+  format::Writer writer;
+  writer.WriteHeader(300);
+  writer.BeginHostObject(2, 2);
+  writer.WriteEntry(0);
+  writer.WriteInt32(1);
+  writer.WriteString("y");
+  writer.BeginHostObject(HostClass::kNamed, "Point", 1);
+  writer.WriteEntry(1);
+  writer.WriteNull();
+  writer.EndHostObject();
+  CHECK(writer.EndHostObject());
+  CHECK(writer.ok());
+  auto [data, size] = writer.sink().Release();
+
+  uint32_t id = 0;
+  CHECK(format::ReadDictionaryHeader(data, size, &id) == 3);
+  CHECK(id == 300);
+  format::Reader reader(data, size);
+  CHECK(reader.ReadHeader());
+  CHECK(reader.hasDictionary() && reader.dictionary() == 300);
+  auto tokens = ReadAll(data, size);
+  std::vector<TokenType> expected = {
+    TokenType::kBeginHostObject, TokenType::kEntry,
+    TokenType::kInt32,           TokenType::kString,
+    TokenType::kBeginHostObject, TokenType::kEntry,
+    TokenType::kNull,            TokenType::kEndHostObject,
+    TokenType::kEndHostObject,   TokenType::kEnd,
+  };
+  CHECK(tokens.size() == expected.size());
+  for (size_t i = 0; i < std::min(tokens.size(), expected.size()); ++i) {
+    CHECK(tokens[i].type == expected[i]);
+  }
+  if (tokens.size() == expected.size()) {
+    CHECK(tokens[0].hostClass == HostClass::kEntry);
+    CHECK(tokens[0].uint32 == 2);
+    CHECK(tokens[1].uint32 == 0);
+    CHECK(tokens[4].hostClass == HostClass::kNamed);
+    CHECK(tokens[5].uint32 == 1);
+  }
+
+  // Without the dictionary header, entries are rejected.
+  const char* error = nullptr;
+  ReadAll(data + 3, size - 3, &error);
+  CHECK(error != nullptr);
+  std::free(data);
+
+  // Output of `serialize([new Point(1, 'two'), { label: Symbol.for('v') }])`
+  // with dictionary 300 of 'Point', 'label', 'x' and 'y'.
+  auto addon = FromHex(
+    "feac02ff0f41025c4900020302004902030300220374776f5c5f01030101220176240002");
+  tokens = ReadAll(addon.data(), addon.size(), &error);
+  CHECK(error == nullptr);
+  CHECK(tokens.size() == 13);
+  if (tokens.size() == 13) {
+    CHECK(tokens[1].hostClass == HostClass::kEntry && tokens[1].uint32 == 0);
+    CHECK(tokens[2].type == TokenType::kEntry && tokens[2].uint32 == 2);
+    CHECK(tokens[5].string.ToUtf8() == "two");
+    CHECK(tokens[7].hostClass == HostClass::kPlain);
+    CHECK(tokens[8].type == TokenType::kEntry && tokens[8].uint32 == 1);
+  }
+
+  format::Writer misuse;
+  misuse.WriteHeader();
+  misuse.BeginHostObject(0, 0);
+  CHECK(!misuse.ok());
+
+  format::Writer value;
+  value.WriteHeader(1);
+  value.BeginHostObject(HostClass::kPlain, "", 1);
+  value.WriteString("key");
+  value.WriteEntry(0); // Entries cannot be values
+  CHECK(!value.ok());
+}
+
+// Values whose strings V8 writes in one-byte or two-byte form, and
+// resizable array buffers.
+static void TestV8Encodings() {
+  const uint8_t cafe[] = {'c', 'a', 'f', 0xe9};
+  format::StringView latin1;
+  latin1.data = cafe;
+  latin1.size = sizeof(cafe);
+  format::Writer regexp;
+  regexp.WriteHeader();
+  regexp.WriteRegExp(latin1, 1); // /café/g
+  auto [pattern, patternSize] = regexp.sink().Release();
+  CHECK(
+    std::vector<uint8_t>(pattern, pattern + patternSize) ==
+    FromHex("ff0f522204636166e901"));
+  std::free(pattern);
+
+  const uint8_t zeros[4] = {};
+  format::Writer buffer;
+  buffer.WriteHeader();
+  buffer.WriteResizableArrayBuffer(zeros, 4, 16);
+  auto [out, size] = buffer.sink().Release();
+  CHECK(std::vector<uint8_t>(out, out + size) == FromHex("ff0f7e041000000000"));
+  auto tokens = ReadAll(out, size);
+  CHECK(!tokens.empty() && tokens[0].resizable);
+  CHECK(tokens[0].byteLength == 4 && tokens[0].maxByteLength == 16);
+  std::free(out);
+
+  const char* error = nullptr;
+  auto oversized = FromHex("ff0f7e080400000000");
+  ReadAll(oversized.data(), oversized.size(), &error);
+  CHECK(error != nullptr);
+}
+
+static void TestChecksum() {
+  const char* check = "123456789";
+  CHECK(
+    checksum::Crc32c(reinterpret_cast<const uint8_t*>(check), 9) ==
+    0xe3069283);
+  std::vector<uint8_t> data(200000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 31);
+  }
+  size_t payloadSize = data.size();
+  data.resize(payloadSize + checksum::TrailerSize(payloadSize));
+  checksum::WriteTrailer(data.data(), payloadSize);
+  checksum::Trailer trailer;
+  uint32_t badBlock = 0;
+  CHECK(
+    checksum::Verify(data.data(), data.size(), &trailer, &badBlock) ==
+    checksum::Status::kOk);
+  CHECK(trailer.payloadSize == payloadSize);
+  data[checksum::kBlockSize * 2 + 1] ^= 1;
+  CHECK(
+    checksum::Verify(data.data(), data.size(), &trailer, &badBlock) ==
+    checksum::Status::kMismatch);
+  CHECK(badBlock == 2);
+  CHECK(!checksum::VerifyBlock(data.data(), trailer, 2));
+  CHECK(checksum::VerifyBlock(data.data(), trailer, 3));
+}
+
+static void TestHash() {
+  auto bytes = [](const char* text) {
+    return reinterpret_cast<const uint8_t*>(text);
+  };
+  CHECK(hash::Hash64(bytes(""), 0) == 0xef46db3751d8e999);
+  CHECK(hash::Hash64(bytes("abc"), 3) == 0x44bc2cf5ad770999);
+  const char* text = "Nobody inspects the spammish repetition";
+  CHECK(hash::Hash64(bytes(text), std::strlen(text)) == 0xfbcea83c8a378bf1);
+
+  std::vector<uint8_t> data(10000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 7);
+  }
+  hash::Hasher64 hasher;
+  for (size_t i = 0, n = 1; i < data.size(); i += n, n = n % 61 + 1) {
+    hasher.Update(data.data() + i, std::min(n, data.size() - i));
+  }
+  CHECK(hasher.Digest() == hash::Hash64(data.data(), data.size()));
+
+  // Reserved space is filled in after it is handed out.
+  format::BasicWriter<format::HashingSink> hashing;
+  hashing.WriteHeader();
+  hashing.BeginArray(1000);
+  for (int i = 0; i < 1000; ++i) {
+    if (uint8_t* chars = hashing.ReserveOneByteString(8)) {
+      std::memcpy(chars, "fragment", 8);
+    }
+  }
+  CHECK(hashing.EndArray());
+  uint64_t digest = hashing.sink().Digest();
+  auto [out, size] = hashing.sink().Release();
+  CHECK(size > format::HashingSink::kChunkSize);
+  CHECK(digest == hash::Hash64(out, size));
+  std::free(out);
+}
+
+int main() {
+  TestReadsAddonOutput();
+  TestRoundTrip();
+  TestCountingSink();
+  TestWriterMisuse();
+  TestRejectsMalformedInput();
+  TestDictionary();
+  TestV8Encodings();
+  TestChecksum();
+  TestHash();
+  if (failures) {
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("All format checks passed\n");
+  return 0;
+}
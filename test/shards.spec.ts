@@ -0,0 +1,158 @@
+import { assert, expect } from 'chai';
+import path from 'node:path';
+import { processShards, readShard, Serialism } from '..';
+
+class Entry {
+  public id: number;
+  public tags: string[];
+
+  constructor(id: number) {
+    this.id = id;
+    this.tags = [`tag${id}`];
+  }
+}
+
+describe('Sharding', function () {
+  const serializer = new Serialism().register(Entry);
+
+  it('splits and merges arrays', function () {
+    const value = [1, , 'three', new Entry(4), { five: 5 }, [6], , ,];
+    const shards = serializer.serializeSharded(value, 3);
+    assert.lengthOf(shards, 3);
+    const merged = serializer.deserializeShards<unknown[]>(shards);
+    assert.deepEqual(merged, value);
+    assert.lengthOf(merged, value.length);
+    assert.isFalse(1 in merged);
+    assert.instanceOf(merged[3], Entry);
+  });
+
+  it('produces shards that decode independently', function () {
+    const value = Array.from({ length: 10 }, (_, i) => new Entry(i));
+    const shards = serializer.serializeSharded(value, 4);
+    const parts = shards.map((shard) => serializer.deserialize<Entry[]>(shard));
+    assert.deepEqual(
+      parts.map((part) => part.length),
+      [2, 3, 2, 3],
+    );
+    assert.deepEqual(parts.flat(), value);
+  });
+
+  it('splits and merges maps and sets', function () {
+    const map = new Map<unknown, unknown>(
+      Array.from({ length: 7 }, (_, i) => [i, new Entry(i)]),
+    );
+    const set = new Set(['a', 'b', 'c']);
+    assert.deepEqual(
+      serializer.deserializeShards(serializer.serializeSharded(map, 3)),
+      map,
+    );
+    const shards = serializer.serializeSharded(set, 2);
+    assert.lengthOf(shards, 2);
+    assert.deepEqual(serializer.deserializeShards(shards), set);
+  });
+
+  it('produces at most one shard per item', function () {
+    assert.lengthOf(serializer.serializeSharded(new Set([1, 2, 3]), 5), 3);
+    assert.lengthOf(serializer.serializeSharded([1], 1e9), 1);
+    assert.lengthOf(serializer.serializeSharded([1], 2 ** 31), 1);
+    const empty = serializer.serializeSharded([], 4);
+    assert.lengthOf(empty, 1);
+    assert.deepEqual(serializer.deserializeShards(empty), []);
+  });
+
+  it('shards sparse arrays by their elements', function () {
+    const value: unknown[] = [];
+    value.length = 2 ** 32 - 1;
+    value[3] = 'three';
+    value[2 ** 31] = new Entry(31);
+    value[2 ** 32 - 2] = 'last';
+    const shards = serializer.serializeSharded(value, 4);
+    assert.lengthOf(shards, 4);
+    const parts = shards.map((shard) =>
+      serializer.deserialize<unknown[]>(shard),
+    );
+    assert.strictEqual(parts[0][3], 'three');
+    assert.lengthOf(Object.keys(parts[1]), 0);
+    const merged = serializer.deserializeShards<unknown[]>(shards);
+    assert.lengthOf(merged, 2 ** 32 - 1);
+    assert.deepEqual(Object.keys(merged), ['3', '2147483648', '4294967294']);
+    assert.instanceOf(merged[2 ** 31], Entry);
+    assert.strictEqual(merged[2 ** 32 - 2], 'last');
+  });
+
+  it('keeps references within a shard', function () {
+    const shared = { value: 1 };
+    const merged = serializer.deserializeShards<unknown[]>(
+      serializer.serializeSharded([shared, shared, shared], 2),
+    );
+    assert.strictEqual(merged[1], merged[2]);
+    assert.notStrictEqual(merged[0], merged[1]);
+  });
+
+  it('honours the instance options', function () {
+    const checked = new Serialism({ checksum: true, traversal: 'iterative' });
+    const shards = checked.serializeSharded([1, 2, 3], 2);
+    assert.deepEqual(checked.deserializeShards(shards), [1, 2, 3]);
+    shards[1][4] ^= 0xff;
+    expect(() => checked.deserializeShards(shards)).to.throw(
+      'Checksum mismatch',
+    );
+    const canonical = new Serialism({ canonical: true });
+    const map = new Map([
+      ['b', 1],
+      ['a', 2],
+      ['d', 3],
+      ['c', 4],
+    ]);
+    const [first] = canonical.serializeSharded(map, 2);
+    const sorted = new Map([
+      ['a', 2],
+      ['b', 1],
+    ]);
+    assert.isTrue(first.equals(canonical.serialize(sorted)));
+  });
+
+  it('processes shards in worker threads', async function () {
+    const value = Array.from({ length: 10 }, (_, i) => new Entry(i));
+    const ids = await processShards<number[]>(
+      serializer.serializeSharded(value, 3),
+      path.join(__dirname, 'fixtures', 'shard-worker.ts'),
+    );
+    assert.deepEqual(ids, [
+      [0, 1, 2],
+      [3, 4, 5],
+      [6, 7, 8, 9],
+    ]);
+  });
+
+  it('reports workers that fail', async function () {
+    let error: Error | undefined;
+    await processShards(
+      serializer.serializeSharded([1], 1),
+      'throw new Error("failed in worker")',
+      { eval: true },
+    ).catch((caught: Error) => (error = caught));
+    assert.strictEqual(error?.message, 'failed in worker');
+    expect(() => readShard(serializer)).to.throw(
+      'readShard() must be called in a worker started by processShards()',
+    );
+  });
+
+  it('rejects invalid arguments', function () {
+    expect(() =>
+      serializer.serializeSharded({} as unknown as unknown[], 2),
+    ).to.throw('Only arrays, maps and sets can be sharded');
+    expect(() => serializer.serializeSharded([1], 0)).to.throw(
+      'Shard count must be a positive integer',
+    );
+    expect(() => serializer.deserializeShards([])).to.throw(
+      'Argument must be a non-empty array of shards',
+    );
+    expect(() =>
+      serializer.deserializeShards([
+        serializer.serialize([1]),
+        serializer.serialize(new Set([2])),
+      ]),
+    ).to.throw('All shards must contain the same kind of container');
+  });
+});
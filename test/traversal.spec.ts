@@ -0,0 +1,133 @@
+import { assert, expect } from 'chai';
+import { Serialism } from '..';
+
+class Link {
+  public next: Link | null = null;
+  public owner: Link | null = null;
+  public label: string;
+
+  constructor(label: string) {
+    this.label = label;
+  }
+}
+
+describe('Iterative traversal', function () {
+  const iterative = new Serialism({ traversal: 'iterative' }).register(Link);
+  const recursive = new Serialism().register(Link);
+
+  it('handles deeply nested objects and arrays', function () {
+    let list: { next?: unknown } = {};
+    let nested: unknown[] = [];
+    for (let i = 0; i < 200000; ++i) {
+      list = { next: list };
+      nested = [nested];
+    }
+    const result = iterative.deserialize<typeof list>(
+      iterative.serialize(list),
+    );
+    let depth = 0;
+    for (let node = result; node.next; ++depth) {
+      node = node.next as typeof node;
+    }
+    assert.strictEqual(depth, 200000);
+    let array = iterative.deserialize<unknown[]>(iterative.serialize(nested));
+    for (depth = 0; array.length; ++depth) {
+      array = array[0] as unknown[];
+    }
+    assert.strictEqual(depth, 200000);
+  });
+
+  it('handles deep chains of registered classes', function () {
+    const head = new Link('0');
+    let tail = head;
+    for (let i = 1; i < 100000; ++i) {
+      tail.next = new Link(String(i));
+      tail.next.owner = head;
+      tail = tail.next;
+    }
+    const result = iterative.deserialize<Link>(iterative.serialize(head));
+    let count = 1;
+    for (let node = result; node.next; ++count) {
+      node = node.next;
+      assert.strictEqual(node.owner, result);
+    }
+    assert.instanceOf(result, Link);
+    assert.strictEqual(count, 100000);
+  });
+
+  it('produces the same bytes as recursive traversal', function () {
+    const shared = { value: 'shared' };
+    const target = {
+      integers: [1, 2, 3],
+      doubles: [1, 2.5, -0],
+      numbers: { a: -0, b: 2.5, c: NaN, d: 2 ** 40, e: 10n ** 30n },
+      strings: ['', 'ascii', 'ünïcödé', '😀'],
+      sparse: [1, , 3],
+      date: new Date(0),
+      regexp: /ab+c/gi,
+      map: new Map<unknown, unknown>([['key', shared]]),
+      set: new Set([shared, null, undefined]),
+      bytes: new Uint16Array([1, 2, 3]),
+      boxed: [Object('text'), Object(1), Object(true)],
+      link: new Link('link'),
+      shared,
+    };
+    assert.deepEqual(iterative.serialize(target), recursive.serialize(target));
+  });
+
+  it('writes strings inside other values like V8', function () {
+    const symbol = Symbol.for('ünï 😀');
+    const resizable = new ArrayBuffer(4, { maxByteLength: 8 });
+    const target = {
+      regexps: [/ünï+/u, /😀/],
+      boxed: [Object('ünïcödé'), Object('😀')],
+      symbols: { [symbol]: symbol },
+      resizable: [resizable, new Uint8Array(resizable, 1, 2)],
+    };
+    const buffer = iterative.serialize(target);
+    assert.isTrue(buffer.equals(recursive.serialize(target)));
+    const result = iterative.deserialize<typeof target>(buffer);
+    assert.deepEqual(result, recursive.deserialize(buffer));
+    assert.isTrue(result.resizable[0].resizable);
+  });
+
+  it('reads and writes recursive payloads', function () {
+    const link = new Link('a');
+    link.next = new Link('b');
+    const target = { link, list: [link.next, { x: 1 }], map: new Map([[1, 2]]) };
+    const fromRecursive = iterative.deserialize(recursive.serialize(target));
+    const fromIterative = recursive.deserialize(iterative.serialize(target));
+    assert.deepEqual(fromRecursive, target);
+    assert.deepEqual(fromIterative, target);
+  });
+
+  it('reports the same errors', function () {
+    expect(() => iterative.serialize({ fn: () => 1 })).to.throw(
+      'could not be cloned.',
+    );
+    expect(() => iterative.serialize(new SharedArrayBuffer(4))).to.throw(
+      '#<SharedArrayBuffer> could not be cloned.',
+    );
+    expect(() =>
+      new Serialism({ traversal: 'iterative' }).serialize(new Link('x')),
+    ).to.throw('No registered class found for Link');
+    expect(() =>
+      new Serialism({ traversal: 'iterative' }).deserialize(
+        iterative.serialize(new Link('x')),
+      ),
+    ).to.throw('No registered class found for: Link');
+  });
+
+  it('rejects malformed payloads', function () {
+    const data = iterative.serialize({ a: [1, 2, 3] });
+    expect(() =>
+      iterative.deserialize(data.subarray(0, data.length - 3)),
+    ).to.throw('Invalid data');
+  });
+
+  it('rejects unknown traversal modes', function () {
+    expect(
+      () => new Serialism({ traversal: 'sideways' as 'iterative' }),
+    ).to.throw("Option 'traversal' must be 'recursive' or 'iterative'");
+  });
+});